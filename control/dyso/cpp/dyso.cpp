@@ -176,6 +176,8 @@ int app_dyso(bf_switchd_context_t *switchd_ctx) {
     uint32_t nGridToRecord = nGridSize;
 
     while (true) {
+        // sleep until the next grid, instead of polling the clock (and the driver session) in a tight loop
+        std::this_thread::sleep_until(init_time + std::chrono::milliseconds(nGridToRecord + 1));
         auto now = std::chrono::system_clock::now();
 
         /**
@@ -0,0 +1,47 @@
+#include <getopt.h>
+
+#include <chrono>
+
+#include "src/KeyMap_multicore.h"
+
+/**
+ *
+ * Builder of the shared keymap (see "src/KeyMap_multicore.h")
+ *
+ * It computes (row, hashkey) of all pre-installed keys once with multiple threads,
+ * and publishes them grouped by rows at the shared memory KEYMAP_SHM_NAME.
+ * Run it before the DySO workers (dyso_multicore.o), which then bulk-load their rows from the keymap.
+ * Without the keymap, each worker hashes all keys by itself.
+ *
+ */
+
+int main(int argc, char* argv[]) {
+    uint32_t nThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    int opt;
+    while ((opt = getopt(argc, argv, "j:h")) != -1) {
+        switch (opt) {
+            case 'j': nThreads = atoi(optarg); break;
+            default:
+                printf("Usage: %s [-j <threads> (default: %u)]\n", argv[0], nThreads);
+                exit(1);
+        }
+    }
+
+    KeyRanges ranges = getDefaultKeyRanges();
+    printf("[KeyMap] Build keymap of %lu key ranges with %u threads...\n", ranges.size(), nThreads);
+    auto start = std::chrono::steady_clock::now();
+    if (!KeyMap::build(ranges, nThreads)) {
+        std::cerr << "[KeyMap] Failed to build the keymap" << std::endl;
+        exit(1);
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+    KeyMap keymap;
+    if (!keymap.attach(ranges)) {
+        std::cerr << "[KeyMap] Failed to attach the published keymap" << std::endl;
+        exit(1);
+    }
+    printf("[KeyMap] Published %lu keys at %s (%ld ms)\n", keymap.size(), KEYMAP_SHM_NAME, elapsed);
+    return 0;
+}
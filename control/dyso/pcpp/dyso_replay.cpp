@@ -0,0 +1,296 @@
+#include <getopt.h>
+
+#include <deque>
+#include <fstream>
+#include <random>
+
+#include "src/DysoWorker_multicore.h"
+
+/**
+ *
+ * Offline trace-replay harness of DySO policy engine (no DPDK, no Tofino)
+ *
+ * (1) Messages
+ * It feeds one DysoWorker with the same 64-bit messages that "dyso_multicore.cpp" pulls off qRxSPSC,
+ * i.e., (dysoIdx << 32) | hashkey, either from
+ *  -- a recorded trace : binary file of uint64_t messages (host-endian), e.g., dumped by option -W, or
+ *  -- a synthetic stream : queries sampled from "misc/zipf.txt" like the query generator (pipe 0),
+ *     with the key offset shifted periodically to simulate dynamic popularity.
+ * Only the signatures of rows associated to the given worker are replayed (ACKs in a trace are ignored).
+ *
+ * (2) ACKs
+ * The harness plays the role of UpdateWorkerThread and the data plane.
+ * Every {updatePeriod} messages it dequeues one UPDATE from the worker's TX queue,
+ * and returns its ACK to the worker after {ackDelay} messages.
+ * Note: the TX queue is the same shared-memory queue as the deployment, so do not run it next to pcpp_dyso.
+ *
+ * (3) Report
+ * For every {reportInterval} messages, it prints ns/msg, msgs/s, virtual hit ratio (cache status of
+ * main policies when a signature arrives) and the self-tuned aging period.
+ *
+ */
+
+void printUsage(const char* prog) {
+    printf("Usage: %s [options]\n", prog);
+    printf("  -w <idx>     DySO worker index to replay (default: 0)\n");
+    printf("  -N <num>     number of DySO workers (default: %u)\n", DEFAULT_NUM_DYSO_WORKER);
+    printf("  -P <name>    row partition to DySO workers, mod or block (default: mod)\n");
+    printf("  -t <file>    recorded trace of uint64_t messages (default: synthetic from zipf)\n");
+    printf("  -z <file>    flowIDs of the query generator (default: ./misc/zipf.txt)\n");
+    printf("  -n <num>     number of synthetic messages for this worker (default: 16777216)\n");
+    printf("  -o <num>     key offset step of popularity change (default: 1000)\n");
+    printf("  -O <num>     messages between popularity changes, 0 for static (default: 0)\n");
+    printf("  -s <seed>    random seed of synthetic stream (default: 1)\n");
+    printf("  -W <file>    dump the message stream to file (as a trace)\n");
+    printf("  -a <num>     initial aging period (default: 16)\n");
+    printf("  -u <num>     messages per dequeue of UPDATE (default: 2)\n");
+    printf("  -d <num>     ACK delay in messages (default: 64)\n");
+    printf("  -l <ppm>     loss rate of UPDATE/ACK round trips in parts per million (default: 0)\n");
+    printf("  -r <num>     report interval in messages (default: 1048576)\n");
+    printf("  -k           load pre-installed nodes from the keymap of dyso_keymap.o (if exists)\n");
+    printf("  -p <0|1>     index pre-installed nodes by minimal perfect hash (default: %d)\n", DYSO_NODE_MPHF);
+    printf("  -D           register nodes on demand instead of pre-installing (default: %d)\n", DYSO_NODE_ON_DEMAND);
+    printf("  -L <file>    restore the policy state from a checkpoint instead of installing nodes\n");
+    printf("  -S <file>    checkpoint the policy state at the end (by a forked child, as dyso_multicore.o)\n");
+}
+
+int main(int argc, char* argv[]) {
+    uint32_t workerIdx = 0;
+    uint32_t nDysoWorker = DEFAULT_NUM_DYSO_WORKER;
+    uint32_t partition = ROW_MAP_MODULO;
+    std::string traceFile = "";
+    std::string zipfFile = "./misc/zipf.txt";
+    std::string dumpFile = "";
+    uint64_t nMsgs = (1 << 24);
+    uint64_t offsetStep = 1000;
+    uint64_t offsetPeriod = 0;
+    uint64_t seed = 1;
+    uint32_t agingPeriod = 16;
+    uint64_t updatePeriod = 2;
+    uint64_t ackDelay = 64;
+    uint32_t lossPpm = 0;
+    uint64_t reportInterval = (1 << 20);
+    int perfectHash = DYSO_NODE_MPHF;
+    bool onDemand = (DYSO_NODE_ON_DEMAND == 1);
+    bool useKeyMap = false;
+    std::string loadFile = "";
+    std::string saveFile = "";
+
+    int opt;
+    while ((opt = getopt(argc, argv, "w:N:P:t:z:n:o:O:s:W:a:u:d:l:r:kp:DL:S:h")) != -1) {
+        switch (opt) {
+            case 'w': workerIdx = atoi(optarg); break;
+            case 'N': nDysoWorker = atoi(optarg); break;
+            case 'P':
+                if (!parseRowMapPartition(optarg, partition)) {
+                    printUsage(argv[0]);
+                    exit(1);
+                }
+                break;
+            case 't': traceFile = optarg; break;
+            case 'z': zipfFile = optarg; break;
+            case 'n': nMsgs = strtoull(optarg, nullptr, 10); break;
+            case 'o': offsetStep = strtoull(optarg, nullptr, 10); break;
+            case 'O': offsetPeriod = strtoull(optarg, nullptr, 10); break;
+            case 's': seed = strtoull(optarg, nullptr, 10); break;
+            case 'W': dumpFile = optarg; break;
+            case 'a': agingPeriod = atoi(optarg); break;
+            case 'u': updatePeriod = strtoull(optarg, nullptr, 10); break;
+            case 'd': ackDelay = strtoull(optarg, nullptr, 10); break;
+            case 'l': lossPpm = atoi(optarg); break;
+            case 'r': reportInterval = strtoull(optarg, nullptr, 10); break;
+            case 'k': useKeyMap = true; break;
+            case 'p': perfectHash = atoi(optarg); break;
+            case 'D': onDemand = true; break;
+            case 'L': loadFile = optarg; break;
+            case 'S': saveFile = optarg; break;
+            default: printUsage(argv[0]); exit(1);
+        }
+    }
+    if (!setRowMap(nDysoWorker, partition) || workerIdx >= getNumDysoWorker() || agingPeriod == 0 || updatePeriod == 0 || reportInterval == 0) {
+        printUsage(argv[0]);
+        exit(1);
+    }
+
+    /* (1) prepare the message stream */
+    std::vector<uint64_t> msgs;
+    uint64_t minKey = UINT32_MAX, maxKey = 0;
+    if (!traceFile.empty()) {
+        std::ifstream trace(traceFile, std::ios::binary);
+        if (!trace) {
+            std::cerr << "[Replay] Failed to open trace: " << traceFile << std::endl;
+            exit(1);
+        }
+        uint64_t msg;
+        while (trace.read((char*)&msg, sizeof(msg))) {
+            if ((msg & MSG_MASK_UPDATE_FLAG) == MSG_MASK_UPDATE_FLAG)
+                continue;  // ACKs are simulated
+            if (getReplicaThreadIdx(uint32_t(msg >> 32)) == workerIdx)
+                msgs.push_back(msg);
+        }
+    } else {
+        std::ifstream zipf(zipfFile);
+        if (!zipf) {
+            std::cerr << "[Replay] Failed to open zipf flowIDs: " << zipfFile << std::endl;
+            exit(1);
+        }
+        std::vector<uint32_t> flowIds;
+        uint32_t flowId;
+        while (zipf >> flowId)
+            flowIds.push_back(flowId);
+        if (flowIds.empty()) {
+            std::cerr << "[Replay] No flowID in " << zipfFile << std::endl;
+            exit(1);
+        }
+
+        std::mt19937_64 rng(seed);
+        std::uniform_int_distribution<size_t> sampler(0, flowIds.size() - 1);
+        uint64_t offset = 0, nQueries = 0;
+        msgs.reserve(nMsgs);
+        while (msgs.size() < nMsgs) {
+            // shift popularity ranks
+            if (offsetPeriod > 0 && nQueries > 0 && nQueries % offsetPeriod == 0)
+                offset += offsetStep;
+            nQueries++;
+
+            uint64_t key = offset + flowIds[sampler(rng)];
+            if (key > UINT32_MAX)
+                break;
+            uint32_t netSrcIP = htonl(uint32_t(key));
+            uint32_t dysoIdx = crc32_mpeg_u32(netSrcIP) % REG_LEN_KEY;
+            if (getReplicaThreadIdx(dysoIdx) != workerIdx)
+                continue;
+            uint32_t hashkey = crc32_sw_u32(netSrcIP) & REG_MASK_GET_HASHKEY;
+            msgs.push_back(createMsgToStatThread(dysoIdx, hashkey));
+            minKey = std::min(minKey, key);
+            maxKey = std::max(maxKey, key);
+        }
+    }
+    printf("[Replay] Worker %u: %lu messages (%s)\n", workerIdx, msgs.size(), traceFile.empty() ? "synthetic" : traceFile.c_str());
+
+    if (!dumpFile.empty()) {
+        std::ofstream dump(dumpFile, std::ios::binary);
+        dump.write((const char*)msgs.data(), msgs.size() * sizeof(uint64_t));
+        printf("[Replay] Dumped the messages to %s\n", dumpFile.c_str());
+    }
+
+    /* (2) build the policies and pre-install the nodes */
+    KeyRanges keyRanges = getDefaultKeyRanges();  // the same key space as "dyso_multicore.cpp"
+    const uint64_t upperSrcIP = keyRanges[0].second, lowerSrcIP = keyRanges[1].first;
+    DysoWorker worker(workerIdx, agingPeriod, onDemand);
+    KeyMap keymap;
+    if (!loadFile.empty()) {
+        auto restoreStart = std::chrono::steady_clock::now();
+        if (!worker.restoreCheckpoint(loadFile)) {
+            std::cerr << "[Replay] No valid checkpoint at " << loadFile << std::endl;
+            exit(1);
+        }
+        printf("[Replay] Restored %lu nodes from checkpoint %s (agingPeriod: %u, %.1f ms)\n", worker.getNumNodes(), loadFile.c_str(),
+               worker.getAgingPeriod(), std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - restoreStart).count());
+        keyRanges.clear();
+    } else if (onDemand) {
+        printf("[Replay] Register nodes on demand (up to %u nodes per row)\n", ON_DEMAND_MAX_NODE_PER_ROW);
+        keyRanges.clear();
+        perfectHash = 0;
+    } else if (useKeyMap && keymap.attach(keyRanges)) {
+        printf("[Replay] Load nodes from keymap %s\n", KEYMAP_SHM_NAME);
+        worker.addDefaultNodes(keymap);
+        keyRanges.clear();
+    }
+    if (!onDemand && loadFile.empty() && maxKey >= upperSrcIP) {
+        // synthetic keys shifted beyond the key space
+        keyRanges.emplace_back(std::max(minKey, upperSrcIP), std::min(maxKey + 1, lowerSrcIP));
+    }
+    worker.addDefaultNodes(keyRanges);
+    if (perfectHash && worker.buildPerfectHash()) {
+        printf("[Replay] Perfect hash of %lu nodes (%.2f bits/node)\n", worker.getNodeIndex().sizeStatic(),
+               double(worker.getNodeIndex().sizePerfectHashInBits()) / std::max(worker.getNodeIndex().sizeStatic(), uint64_t(1)));
+    }
+    printf("[Replay] Initializing Done.\n--------\n");
+
+    /* flush the TX queue from prior runs */
+    qTxSPSC* txQueue = getTxQueue(std::to_string(workerIdx));
+    if (txQueue == nullptr) {
+        std::cerr << "[Replay] Failed to open qTxSPSC of idx -" << workerIdx << std::endl;
+        exit(1);
+    }
+    while (txQueue->front() != nullptr)
+        txQueue->pop();
+
+    /* (3) replay */
+    std::deque<std::pair<uint64_t, uint64_t>> pendingAck;  // (due msg, ACK msg)
+    pcpp::dysoCtrlhdr* fetched = nullptr;
+    uint64_t nUpdate = 0, totalUpdate = 0;
+    uint64_t nLost = 0;
+    std::mt19937_64 lossRng(seed);
+    uint64_t lastHit = 0, lastMiss = 0;
+    uint64_t total_elapsed_time = 0;
+    auto start = std::chrono::steady_clock::now();
+    auto begin = start;
+
+    for (uint64_t i = 0; i < msgs.size(); i++) {
+        worker.processMsg(msgs[i]);
+
+        // UpdateWorkerThread: dequeue one UPDATE per control packet
+        if (i % updatePeriod == 0 && (fetched = txQueue->front()) != nullptr) {
+            uint32_t index_update = ntohl(fetched->index_update);
+            txQueue->pop();
+            if (lossPpm == 0 || lossRng() % 1000000 >= lossPpm)
+                pendingAck.emplace_back(i + ackDelay, (uint64_t(index_update) << 32) + MSG_MASK_UPDATE_FLAG);
+            else
+                nLost++;  // UPDATE or its ACK is dropped
+            nUpdate++;
+        }
+
+        // data plane: return ACKs after the delay
+        while (!pendingAck.empty() && pendingAck.front().first <= i) {
+            worker.processMsg(pendingAck.front().second);
+            pendingAck.pop_front();
+        }
+
+        if ((i + 1) % reportInterval == 0 || i + 1 == msgs.size()) {
+            auto end = std::chrono::steady_clock::now();
+            uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+            uint64_t nReport = (i % reportInterval) + 1;
+            uint64_t hit = worker.getSigHit() - lastHit;
+            uint64_t miss = worker.getSigMiss() - lastMiss;
+            printf("[Replay] msgs: %lu, ns/msg: %.1f, Mmsgs/s: %.3f, hitRatio: %.4f, agingPeriod: %u, updates: %lu\n",
+                   i + 1, double(elapsed) / nReport, nReport * 1e3 / elapsed,
+                   double(hit) / std::max(hit + miss, uint64_t(1)), worker.getAgingPeriod(), nUpdate);
+
+            total_elapsed_time += elapsed;
+            totalUpdate += nUpdate;
+            nUpdate = 0;
+            lastHit = worker.getSigHit();
+            lastMiss = worker.getSigMiss();
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    uint64_t totalMsgs = std::max(msgs.size(), size_t(1));
+    uint64_t wallclock = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+    printf("--------\n[Replay] Total msgs: %lu, ns/msg: %.1f, Mmsgs/s: %.3f, hitRatio: %.4f, updates: %lu (wall-clock %.3f s)\n",
+           uint64_t(msgs.size()), double(total_elapsed_time) / totalMsgs, totalMsgs * 1e3 / std::max(total_elapsed_time, uint64_t(1)),
+           double(worker.getSigHit()) / std::max(worker.getSigHit() + worker.getSigMiss(), uint64_t(1)), totalUpdate, wallclock / 1e9);
+    if (lossPpm > 0 || worker.getUpdateTimeout() > 0 || worker.getStaleAck() > 0) {
+        printf("[Replay] Lost UPDATEs: %lu, timeouts: %lu (retransmit: %lu, rollback: %lu), stale ACKs: %lu\n", nLost,
+               worker.getUpdateTimeout(), worker.getUpdateRetransmit(), worker.getUpdateRollback(), worker.getStaleAck());
+    }
+    if (worker.isOnDemand()) {
+        printf("[Replay] On-demand nodes: %lu (registered: %lu, rejected: %lu, unrecoverable: %lu, unknown: %lu)\n",
+               worker.getNumNodes(), worker.getRegistered(), worker.getRejected(), worker.getUnrecoverable(), worker.getUnknownKey());
+    }
+
+    if (!saveFile.empty()) {
+        auto saveStart = std::chrono::steady_clock::now();
+        bool forked = worker.checkpointAsync(saveFile);
+        double forkMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - saveStart).count();
+        if (!forked || !worker.waitCheckpoint()) {
+            std::cerr << "[Replay] Failed to checkpoint to " << saveFile << std::endl;
+            exit(1);
+        }
+        printf("[Replay] Checkpoint %lu nodes to %s (fork: %.1f ms, total: %.1f ms)\n", worker.getNumNodes(), saveFile.c_str(), forkMs,
+               std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - saveStart).count());
+    }
+    return 0;
+}
@@ -0,0 +1,127 @@
+#include <dirent.h>
+#include <getopt.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "src/Telemetry_multicore.h"
+
+/**
+ *
+ * Reader of the telemetry pages of workers (see "src/Telemetry_multicore.h")
+ *
+ * It samples the pages of all running stat, update and DySO workers every interval, and prints one line per worker
+ * with rates over the interval (msgs/s, pkts/s, drops/s) and the current values (ring occupancy, ACK backlog, ...).
+ * Pages are only read (retried while being written), so sampling does not slow down the workers.
+ * With -c, lines are in CSV for plotting (time in ms since start).
+ *
+ */
+
+struct TelemetrySource {
+    std::string name;
+    const TelemetryPage* page;
+    TelemetryCounters last;
+    bool hasLast;
+};
+
+/* attach the pages in /dev/shm not attached yet (workers may start later) */
+void attachPages(std::vector<TelemetrySource>& sources) {
+    const std::string prefix = std::string(TELEMETRY_SHM_PREFIX).substr(1);  // without '/'
+    DIR* dir = opendir("/dev/shm");
+    if (dir == nullptr)
+        return;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        std::string name = std::string("/") + entry->d_name;
+        if (std::string(entry->d_name).compare(0, prefix.size(), prefix) != 0)
+            continue;
+        if (std::any_of(sources.begin(), sources.end(), [&](const TelemetrySource& s) { return s.name == name; }))
+            continue;
+        size_t len = 0;
+        const TelemetryPage* page = (const TelemetryPage*)shm_attach(name.c_str(), len);
+        if (page == nullptr || len < sizeof(TelemetryPage) || !page->isValid())
+            continue;  // being created
+        sources.push_back({name, page, {}, false});
+    }
+    closedir(dir);
+    std::sort(sources.begin(), sources.end(), [](const TelemetrySource& a, const TelemetrySource& b) {
+        return std::make_pair(a.page->getRole(), a.page->getIdx()) < std::make_pair(b.page->getRole(), b.page->getIdx());
+    });
+}
+
+int main(int argc, char* argv[]) {
+    uint32_t intervalUs = 1000000;
+    uint64_t nSamples = 0;  // 0 : forever
+    bool csv = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "i:n:ch")) != -1) {
+        switch (opt) {
+            case 'i': intervalUs = std::max(atoi(optarg), 1); break;
+            case 'n': nSamples = strtoull(optarg, nullptr, 10); break;
+            case 'c': csv = true; break;
+            default:
+                printf("Usage: %s [-i <interval us> (default: %u)] [-n <samples> (default: forever)] [-c (CSV)]\n", argv[0], intervalUs);
+                exit(1);
+        }
+    }
+
+    std::vector<TelemetrySource> sources;
+    auto start = std::chrono::steady_clock::now();
+    auto next = start;
+    if (csv)
+        printf("time_ms,role,idx,msgs_per_sec,pkts_per_sec,drops_per_sec,ring,ack_backlog,inflight,aging,rows,hit_up,hit_down,parked\n");
+
+    for (uint64_t sample = 0; nSamples == 0 || sample < nSamples; sample++) {
+        attachPages(sources);
+        double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (!csv)
+            printf("---- %.3f s, %zu workers\n", elapsedMs / 1000, sources.size());
+
+        for (auto& source : sources) {
+            TelemetryCounters now;
+            uint32_t nRetry = 0;
+            while (!source.page->read(now) && ++nRetry < 1000)
+                std::this_thread::yield();
+            if (nRetry == 1000 || now.timestampNs == 0)
+                continue;  // stuck writer (e.g., killed while writing), or not published yet
+            const char* role = getTelemetryRoleName(source.page->getRole());
+            uint32_t idx = source.page->getIdx();
+            if (source.hasLast && now.timestampNs == source.last.timestampNs) {
+                if (!csv)
+                    printf("[%6s %2u] no update (parked, or exited)\n", role, idx);
+                continue;  // sampled faster than published
+            }
+
+            double dt = source.hasLast ? double(now.timestampNs - source.last.timestampNs) / 1e9 : 0.0;
+            auto rate = [&](const uint64_t& curr, const uint64_t& prev) { return (dt > 0) ? double(curr - prev) / dt : 0.0; };
+            double msgRate = rate(now.nMsgs, source.last.nMsgs);
+            double pktRate = rate(now.nPkts, source.last.nPkts);
+            double dropRate = rate(now.nDropped, source.last.nDropped);
+
+            if (csv) {
+                printf("%.3f,%s,%u,%.0f,%.0f,%.0f,%lu,%lu,%lu,%u,%u,%.4f,%.4f,%lu\n", elapsedMs, role, idx, msgRate, pktRate, dropRate,
+                       now.ringOccupancy, now.ackBacklog, now.nUpdateInFlight, now.agingPeriod, now.nRows, now.hitRatioUp,
+                       now.hitRatioDown, now.nParked);
+            } else if (source.page->getRole() == TELEMETRY_DYSO) {
+                printf("[%6s %2u] msgs/s: %10.0f, ring: %5lu, stray/s: %6.0f, inflight: %4lu, aging: %4u, rows: %5u, replica hit up/down: %.4f/%.4f, parked: %lu\n",
+                       role, idx, msgRate, now.ringOccupancy, dropRate, now.nUpdateInFlight, now.agingPeriod, now.nRows,
+                       now.hitRatioUp, now.hitRatioDown, now.nParked);
+            } else {
+                printf("[%6s %2u] msgs/s: %10.0f, pkts/s: %10.0f, ring: %5lu, drops/s: %6.0f, ACK backlog: %4lu, parked: %lu\n",
+                       role, idx, msgRate, pktRate, now.ringOccupancy, dropRate, now.ackBacklog, now.nParked);
+            }
+            source.last = now;
+            source.hasLast = true;
+        }
+        fflush(stdout);
+
+        next += std::chrono::microseconds(intervalUs);
+        std::this_thread::sleep_until(next);
+    }
+    return 0;
+}
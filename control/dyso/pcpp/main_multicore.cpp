@@ -1,14 +1,72 @@
+#include <pthread.h>
+
+#include <thread>
+
+#include "src/DysoWorkerLoop_multicore.h"
+#include "src/Rebalancer_multicore.h"
 #include "src/StatWorkerThread_multicore.h"
 #include "src/UpdateWorkerThread_multicore.h"
 #include "src/dyso_multicore.hpp"
 
+void printUsage(const char* prog) {
+    printf("Usage: %s [options]\n", prog);
+    printf("  -t           single-process mode : run DySO workers as threads on cores next to DPDK's (instead of dyso_multicore.o)\n");
+    printf("  -w <num>     number of DySO workers (default: %u)\n", DEFAULT_NUM_DYSO_WORKER);
+    printf("  -m <name>    row partition to DySO workers, mod or block (default: mod)\n");
+    printf("  -r           with -t, DySO workers restore their last checkpoint (only for a restart of the control plane)\n");
+}
+
 int main(int argc, char* argv[]) {
+    bool threaded = false;
+    bool restore = false;
+    uint32_t nDysoWorker = DEFAULT_NUM_DYSO_WORKER;
+    uint32_t partition = ROW_MAP_MODULO;
+    int opt;
+    while ((opt = getopt(argc, argv, "tw:m:rh")) != -1) {
+        switch (opt) {
+            case 't': threaded = true; break;
+            case 'r': restore = true; break;
+            case 'w': nDysoWorker = atoi(optarg); break;
+            case 'm':
+                if (!parseRowMapPartition(optarg, partition)) {
+                    printUsage(argv[0]);
+                    exit(1);
+                }
+                break;
+            default: printUsage(argv[0]); exit(1);
+        }
+    }
+
+    // row -> worker assignment, used by stat cores to demultiplex messages (dyso_multicore.o must be given the same)
+    if (!setRowMap(nDysoWorker, partition)) {
+        EXIT_WITH_ERROR("Invalid number of DySO workers (1-" << MAX_DYSO_WORKER << ") or row partition");
+    }
+    printf("DySO workers: %u, row partition: %s\n", getNumDysoWorker(), partition == ROW_MAP_MODULO ? "mod" : "block");
+
     // print PCAP++ version
     printAppVersion();
 
     // Register the on-app-close event-handler
     pcpp::ApplicationEventHandler::getInstance().onApplicationInterrupted(onApplicationInterrupted, NULL);
 
+    // single-process mode : start DySO workers first (on queues in process memory), as installing nodes takes a while
+    std::atomic<uint32_t> nDysoWorkerReady(0);
+    if (threaded) {
+        useLocalQueues() = true;
+        const uint32_t firstCoreForDyso = 1 + nCoreForStat + nCoreForUpdate;  // next to the cores of maskCoreToUse
+        for (uint32_t i = 0; i < getNumDysoWorker(); i++) {
+            std::thread dysoWorkerThread(runDysoWorker, i, true, restore, &nDysoWorkerReady);
+            cpu_set_t cpuset;
+            CPU_ZERO(&cpuset);
+            CPU_SET(firstCoreForDyso + i, &cpuset);
+            if (firstCoreForDyso + i >= std::thread::hardware_concurrency() ||
+                pthread_setaffinity_np(dysoWorkerThread.native_handle(), sizeof(cpu_set_t), &cpuset) != 0) {
+                std::cerr << "Couldn't pin DySO worker " << i << " to core " << firstCoreForDyso + i << std::endl;
+            }
+            dysoWorkerThread.detach();  // runs until the process exits
+        }
+    }
+
     // Get and Set core masks to use
     pcpp::CoreMask coreMaskToUse = pcpp::getCoreMaskForAllMachineCores();
     std::cout << "All available core mask: " << coreMaskToUse << ", MAX_NUM_OF_CORES: " << MAX_NUM_OF_CORES << std::endl;
@@ -55,13 +113,15 @@ int main(int argc, char* argv[]) {
 
     // open and allocate Rx Queues to dpdkDevice
     // uint32_t nTotalStatRxQueue = dpdkDeviceStat->getTotalNumOfRxQueues() >> 1; // 64 Rxqueues
-    uint32_t nTotalStatRxQueue = nCoreForStat;  // total {nCoreForStat} RxQueue (1 queue - 1 core - 1 statWorker)
+    // 1 RxQueue polled by stat core 0 : control packets have a custom ether type, which RSS does not spread,
+    // so stat core 0 steers them to the other stat cores by row in software (see StatWorkerThread)
+    uint32_t nTotalStatRxQueue = 1;
     std::cout << "nTotalStatRxQueue : " << nTotalStatRxQueue << std::endl;
     if (!dpdkDeviceStat->openMultiQueues(nTotalStatRxQueue, 0)) {
         EXIT_WITH_ERROR("Couldn't open DPDK StatDevice #" << dpdkDeviceStat->getDeviceId() << ", PMD '" << dpdkDeviceStat->getPMDName() << "'");
     }
 
-    // total {nCoreForUpdate} Rx / Tx Queues (1 queue - 1 core - 1 updateWorker)
+    // total {nCoreForUpdate} Rx / Tx Queues (1 queue - 1 core - 1 updateWorker, each draining the TX rings of all DySO workers)
     uint32_t nTotalUpdateRxQueue = nCoreForUpdate;
     uint32_t nTotalUpdateTxQueue = nCoreForUpdate;
     std::cout << "nTotalUpdateRxQueue : " << nTotalUpdateRxQueue << std::endl;
@@ -87,19 +147,28 @@ int main(int argc, char* argv[]) {
 
     /********************* DPDK IS READY *******************/
 
-    assert(nCoreForStat == 1);
-    assert(nCoreForUpdate == 1);
+    // single-process mode : wait for DySO workers to be ready for messages
+    if (threaded) {
+        while (nDysoWorkerReady.load() < getNumDysoWorker()) {
+            usleep(100000);
+        }
+        printf("All %u DySO worker threads are ready\n", getNumDysoWorker());
+    }
 
     /**
      * Create and Start DPDK Worker Threads
      */
     
     std::vector<pcpp::DpdkWorkerThread*> dysoWorkerThreadVec;
+    std::vector<StatWorkerThread*> statWorkerVec;
 
     for (uint32_t i = 0; i < nCoreForStat; i++) {
         StatWorkerThread* newStatWorker = new StatWorkerThread(statWorkerConfigArr[i]);
         dysoWorkerThreadVec.push_back(newStatWorker);
+        statWorkerVec.push_back(newStatWorker);
     }
+    for (auto& statWorker : statWorkerVec)
+        statWorker->setPeers(statWorkerVec);
     for (uint32_t i = 0; i < nCoreForUpdate; i++) {
         UpdateWorkerThread* newUpdateWorker = new UpdateWorkerThread(updateWorkerConfigArr[i]);
         dysoWorkerThreadVec.push_back(newUpdateWorker);
@@ -113,10 +182,15 @@ int main(int argc, char* argv[]) {
 
     printf("--------------\nStart running worker threads...\n");
     
-    /* Run Indefinitely */
+    /* Run Indefinitely (moving rows between DySO workers by their loads) */
     printf("Run indefinitely...\n\n\n\n\n");
-    while (true) {
+    Rebalancer rebalancer(statWorkerVec);
+    for (uint64_t sec = 1;; sec++) {
         sleep(1);
+#if (DYSO_REBALANCE_PERIOD_SEC > 0)
+        if (sec % DYSO_REBALANCE_PERIOD_SEC == 0)
+            rebalancer.rebalance();
+#endif
     }
 
     pcpp::DpdkDeviceList::getInstance().stopDpdkWorkerThreads();
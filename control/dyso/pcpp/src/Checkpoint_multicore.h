@@ -0,0 +1,160 @@
+#pragma once
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "dyso_multicore.hpp"
+
+/**
+ * Checkpoint of a DySO worker's policy state, for a warm restart (see DysoWorker::saveCheckpoint).
+ *
+ * The file is written by a forked child (copy-on-write snapshot, the worker keeps running) to a temporary file,
+ * which is renamed at the end, so a reader never sees a partial checkpoint. It is restored by mmap.
+ *
+ * Layout : CheckpointHeader
+ *        | (CheckpointRow, CheckpointNode[nodes of row]) of main policies, up replicas, then down replicas
+ */
+#define CHECKPOINT_PATH_PREFIX "/dev/shm/dyso_checkpoint_"  // + worker index
+#define MIGRATION_PATH_PREFIX "/dev/shm/dyso_migrate_"      // + dyso index, a row in the same layout (see DysoWorker::exportRow)
+constexpr uint64_t CHECKPOINT_MAGIC = 0x445943484B504E54;   // "DYCHKPNT"
+constexpr uint32_t CHECKPOINT_VERSION = 3;
+
+inline std::string getCheckpointPath(const uint32_t& workerIdx) {
+    return std::string(CHECKPOINT_PATH_PREFIX) + std::to_string(workerIdx);
+}
+inline std::string getMigrationPath(const uint32_t& dysoIdx) {
+    return std::string(MIGRATION_PATH_PREFIX) + std::to_string(dysoIdx);
+}
+
+struct CheckpointHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t workerIdx;
+    uint32_t regLenKey;  // configurations must be the same to restore
+    uint32_t nHead;
+    uint32_t stageCache;
+    uint32_t numDysoWorker;
+    uint64_t len;  // bytes of the file
+
+    /* worker states */
+    uint32_t agingPeriod;
+    uint32_t virtualQueueUp;
+    uint32_t virtualQueueDown;
+    uint32_t partition;  // of dysoRowMap (rows of this worker)
+    uint64_t clockCycle;
+    uint64_t nCtrlPktRx;
+
+    /* rows and nodes (for bulk allocation at restore) */
+    uint64_t nPolicies;
+    uint64_t nReplicas;
+    uint64_t nNodes;
+    uint64_t nReplicaNodesUp;
+    uint64_t nReplicaNodesDown;
+};
+
+/* buffered writer to "<path>.tmp", renamed to path at commit */
+class CheckpointWriter {
+   private:
+    FILE* fp_ = nullptr;
+    std::string path_;
+    std::string tmpPath_;
+    uint64_t len_ = 0;
+    bool ok_ = false;
+
+   public:
+    CheckpointWriter(const std::string& path) : path_(path), tmpPath_(path + ".tmp") {
+        fp_ = fopen(tmpPath_.c_str(), "wb");
+        if (fp_ == nullptr)
+            return;
+        setvbuf(fp_, nullptr, _IOFBF, 1 << 20);
+        CheckpointHeader header = {};  // placeholder (magic = 0) until commit
+        ok_ = true;
+        write(&header, sizeof(header));
+    }
+    ~CheckpointWriter() {
+        if (fp_ != nullptr) {
+            fclose(fp_);
+            unlink(tmpPath_.c_str());
+        }
+    }
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+    void write(const void* data, const size_t& len) {
+        ok_ = ok_ && fwrite(data, 1, len, fp_) == len;
+        len_ += len;
+    }
+
+    /* write the header (magic and len are set here), and publish the file */
+    bool commit(CheckpointHeader header) {
+        header.magic = CHECKPOINT_MAGIC;
+        header.version = CHECKPOINT_VERSION;
+        header.len = len_;
+        ok_ = ok_ && fseek(fp_, 0, SEEK_SET) == 0 && fwrite(&header, 1, sizeof(header), fp_) == sizeof(header);
+        ok_ = ok_ && fflush(fp_) == 0 && fsync(fileno(fp_)) == 0;
+        ok_ = (fclose(fp_) == 0) && ok_;
+        fp_ = nullptr;
+        ok_ = ok_ && rename(tmpPath_.c_str(), path_.c_str()) == 0;
+        if (!ok_)
+            unlink(tmpPath_.c_str());
+        return ok_;
+    }
+};
+
+/* read-only mapping of a checkpoint file, consumed in order */
+class CheckpointReader {
+   private:
+    const uint8_t* base_ = nullptr;
+    size_t len_ = 0;
+    size_t offset_ = 0;
+
+   public:
+    CheckpointReader() {}
+    ~CheckpointReader() {
+        if (base_ != nullptr)
+            munmap((void*)base_, len_);
+    }
+    CheckpointReader(const CheckpointReader&) = delete;
+    CheckpointReader& operator=(const CheckpointReader&) = delete;
+
+    /* map the checkpoint, return nullptr if not exist or not written with the same configuration */
+    const CheckpointHeader* open(const std::string& path, const uint32_t& workerIdx) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return nullptr;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(CheckpointHeader)) {
+            close(fd);
+            return nullptr;
+        }
+        void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        close(fd);
+        if (addr == MAP_FAILED)
+            return nullptr;
+        base_ = (const uint8_t*)addr;
+        len_ = st.st_size;
+
+        const CheckpointHeader* header = read<CheckpointHeader>(1);
+        if (header->magic != CHECKPOINT_MAGIC || header->version != CHECKPOINT_VERSION || header->len != len_ ||
+            header->workerIdx != workerIdx || header->regLenKey != REG_LEN_KEY || header->nHead != N_HEAD ||
+            header->stageCache != STAGE_CACHE || header->numDysoWorker != getNumDysoWorker() ||
+            header->partition != dysoRowMap.getPartition())
+            return nullptr;
+        return header;
+    }
+
+    /* next n records, nullptr if beyond the file */
+    template <typename T>
+    const T* read(const size_t& n) {
+        if (offset_ + n * sizeof(T) > len_)
+            return nullptr;
+        const T* records = (const T*)(base_ + offset_);
+        offset_ += n * sizeof(T);
+        return records;
+    }
+};
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <atomic>
+
+#include "DysoWorker_multicore.h"
+#include "Telemetry_multicore.h"
+
+/**
+ * Main loop of a DySO worker : digest the messages of its RX queues from the stat cores, forever.
+ * It runs as a worker process (dyso_multicore.o <idx>) on queues in shared memory,
+ * or as a thread of pcpp_dyso.o in the single-process mode (pcpp_dyso.o -t) on queues in process memory.
+ *
+ * nReady (if given) is incremented once the nodes are installed, i.e., the worker is ready for messages.
+ * With restore, the worker resumes from its last checkpoint (if any) instead of installing nodes : only for a restart
+ * of the control plane, as the cache view in the checkpoint must match the data plane.
+ * In the single-process mode, the periodic checkpoint is disabled, as forking the multi-threaded DPDK process
+ * is not safe (a checkpoint can still be restored at start).
+ */
+void runDysoWorker(const uint32_t& dyso_index_, const bool& inProcess, const bool& restore, std::atomic<uint32_t>* nReady = nullptr) {
+    /* get RX Msg Queues (via shared memory, or process memory) from DPDK's StatThreads */
+    printf("Running DySO of Core %u%s\n", dyso_index_, inProcess ? " (thread)" : "");
+    qRxSPSC* rxQueue[nCoreForStat];
+    for (uint32_t i = 0; i < nCoreForStat; i++) {
+        if ((rxQueue[i] = getRxQueue(i, dyso_index_)) == nullptr) {
+            std::cerr << "Failed to open qRxSPSC of idx -" << i << "_" << dyso_index_ << std::endl;
+            exit(1);
+        }
+    }
+    Doorbell* doorbell = getDoorbell(dyso_index_);  // rung by stat cores, while this worker is parked
+    if (doorbell == nullptr) {
+        std::cerr << "Failed to open doorbell of idx -" << dyso_index_ << std::endl;
+        exit(1);
+    }
+    doorbell->parked.store(0);  // e.g., left by a killed worker
+    IdleBackoff backoff(IDLE_SPIN_POLLS, IDLE_PAUSE_POLLS, IDLE_MAX_PAUSE);
+
+    /* initialize DySO's default nodes (for read-centric evaluation) */
+    uint32_t agingPeriod = 16;  // global aging period (to be adjusted)
+    DysoWorker worker(dyso_index_, agingPeriod, DYSO_NODE_ON_DEMAND == 1);
+
+    printf("--------\n[%u] Generated %lu dyso, and (%lu)x2 up/down replicas\n",
+           dyso_index_, worker.getNumPolicies(), worker.getNumReplicas());
+
+    /* warm restart : resume the policy state of the last checkpoint of this worker (if asked, and any) */
+    const std::string checkpointPath = getCheckpointPath(dyso_index_);
+    bool restored = false;
+    if (restore) {
+        auto start = std::chrono::steady_clock::now();
+        if ((restored = worker.restoreCheckpoint(checkpointPath))) {
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+            printf("[%u] Restored %lu nodes from checkpoint %s (agingPeriod: %u, %ld ms)\n",
+                   dyso_index_, worker.getNumNodes(), checkpointPath.c_str(), worker.getAgingPeriod(), elapsed);
+        } else {
+            printf("[%u] No valid checkpoint at %s, start fresh\n", dyso_index_, checkpointPath.c_str());
+        }
+    }
+
+    /* pre-install the nodes of 4B keys to be queried in the simulation
+     * XXX: this one is to pre-register/generate nodes into DySO Stat Engine for simulation.
+     * With DYSO_NODE_ON_DEMAND, keys are registered on demand instead (see DysoWorker::registerOnDemand).
+     */
+    if (!restored) {
+#if (DYSO_NODE_ON_DEMAND == 1)
+        printf("[%u] agingPeriod: %u\n", dyso_index_, agingPeriod);
+        printf("[%u] Register nodes on demand (up to %u nodes per row)\n", dyso_index_, ON_DEMAND_MAX_NODE_PER_ROW);
+#else
+        KeyRanges keyRanges = getDefaultKeyRanges();
+        printf("[%u] Start initializing Dyso nodes...\n", dyso_index_);
+        printf("[%u] agingPeriod: %u\n", dyso_index_, agingPeriod);
+        printf("[%u] Range: [%lu, %lu) and [%lu, %lu)\n", dyso_index_, keyRanges[0].first, keyRanges[0].second, keyRanges[1].first, keyRanges[1].second);
+
+        // generate candidate nodes (bulk-load from the keymap if it is published by dyso_keymap.o)
+        KeyMap keymap;
+        if (keymap.attach(keyRanges)) {
+            printf("[%u] Load nodes from keymap %s\n", dyso_index_, KEYMAP_SHM_NAME);
+            worker.addDefaultNodes(keymap);
+        } else {
+            printf("[%u] No keymap at %s, hash all keys (run dyso_keymap.o first to speed up)\n", dyso_index_, KEYMAP_SHM_NAME);
+            worker.addDefaultNodes(keyRanges);
+        }
+#endif
+    }
+#if (DYSO_NODE_MPHF == 1 && DYSO_NODE_ON_DEMAND == 0)
+    // the key set is static from now on (except on-demand ones), so index it by a minimal perfect hash
+    if (worker.buildPerfectHash()) {
+        printf("[%u] Perfect hash of %lu nodes (%.2f bits/node)\n", dyso_index_, worker.getNodeIndex().sizeStatic(),
+               double(worker.getNodeIndex().sizePerfectHashInBits()) / std::max(worker.getNodeIndex().sizeStatic(), uint64_t(1)));
+    }
+#endif
+
+    printf("[%u] Initializing Done.\n--------\n", dyso_index_);
+    if (nReady != nullptr)
+        nReady->fetch_add(1);
+
+    /* run by digesting the reports from data plane, and run self-tuning */
+
+    uint64_t total_elapsed_time = 0;
+    uint64_t total_number_of_msgs = 0;
+    auto start_ts_per_batch = std::chrono::steady_clock::now();
+    auto finish_ts_per_batch = std::chrono::steady_clock::now();
+    uint64_t batch_size = 0;
+#if (DYSO_CHECKPOINT_PERIOD_SEC > 0)
+    auto last_checkpoint_ts = std::chrono::steady_clock::now();
+#endif
+    TelemetryWriter telemetry(TELEMETRY_DYSO, dyso_index_, DYSO_TELEMETRY_PERIOD_US);
+    TelemetryCounters counters = {};
+    
+    while (true) {
+        start_ts_per_batch = std::chrono::steady_clock::now();
+
+        // (1) process the msgs in place at the slots of each rxQueue (in batch of 1000, shared fairly by stat cores),
+        // (2) and release them at once per contiguous span (at most two at the wrap-around)
+        batch_size = 0;
+        for (uint32_t q = 0; q < nCoreForStat; q++) {
+            constexpr uint32_t batchPerQueue = (1000 + nCoreForStat - 1) / nCoreForStat;
+            uint32_t queue_batch_size = 0;
+            uint32_t span_size = 0;
+            const uint64_t* span = nullptr;
+            while (queue_batch_size < batchPerQueue && (span = rxQueue[q]->frontN(batchPerQueue - queue_batch_size, span_size)) != nullptr) {
+                for (uint32_t i = 0; i < span_size; i++) {
+                    worker.processMsg(span[i]);
+                }
+                rxQueue[q]->popN(span_size);
+                queue_batch_size += span_size;
+            }
+            batch_size += queue_batch_size;
+        }
+#if (DYSODEBUG == 2)
+        if (batch_size > 0)
+            printf("[%u INFO] Received batch msg: %lu\n", dyso_index_, batch_size);
+#endif
+
+        // publish telemetry (see Telemetry_multicore.h)
+        counters.nMsgs += batch_size;
+        if (telemetry.due(start_ts_per_batch)) {
+            counters.nDropped = worker.getStrayMsg();
+            counters.ringOccupancy = 0;
+            for (uint32_t q = 0; q < nCoreForStat; q++)
+                counters.ringOccupancy += rxQueue[q]->size();
+            counters.nUpdateInFlight = worker.getNumUpdateInFlight();
+            counters.nParked = backoff.getNumPark();
+            counters.agingPeriod = worker.getAgingPeriod();
+            counters.nRows = worker.getNumRows();
+            counters.hitRatioUp = worker.getReplicaHitRatio(true);
+            counters.hitRatioDown = worker.getReplicaHitRatio(false);
+            telemetry.publish(counters, start_ts_per_batch);
+        }
+
+        // load the rows moving in from other workers, once exported (see DysoWorker::importMigratedRows)
+        if (worker.hasPendingMigration())
+            worker.importMigratedRows();
+
+#if (DYSO_IDLE_PARK == 1)
+        // (3) spin, then pause, then park until a stat core pushes msgs (not while waiting for a row moving in)
+        if (batch_size > 0) {
+            backoff.reset();
+        } else if (backoff.idle() && !worker.hasPendingMigration()) {
+            doorbell->park([&]() {
+                for (uint32_t q = 0; q < nCoreForStat; q++) {
+                    if (rxQueue[q]->front() != nullptr)
+                        return false;
+                }
+                return true;
+            }, IDLE_PARK_US);
+        }
+#endif
+
+
+        /* LOGGING TIMESTAMP */
+        if (batch_size > 0) {
+            finish_ts_per_batch = std::chrono::steady_clock::now();
+            auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(finish_ts_per_batch - start_ts_per_batch).count();
+            total_elapsed_time += uint64_t(elapsed);
+            total_number_of_msgs += batch_size;
+        }
+
+        if (total_number_of_msgs > (1 << 23)) {
+            printf("[DySO %u] Avg time to process 1 msg: %lu (ns), unknown keys: %lu\n", dyso_index_, total_elapsed_time / total_number_of_msgs, worker.getUnknownKey());
+#if (DYSO_IDLE_PARK == 1)
+            printf("[DySO %u] Parked: %lu times (woken by stat cores: %lu)\n", dyso_index_, backoff.getNumPark(), doorbell->nWakeup.load());
+#endif
+            printf("[DySO %u] UPDATE timeouts: %lu (retransmit: %lu, rollback: %lu), stale ACKs: %lu\n", dyso_index_,
+                   worker.getUpdateTimeout(), worker.getUpdateRetransmit(), worker.getUpdateRollback(), worker.getStaleAck());
+#if (DYSO_REBALANCE_PERIOD_SEC > 0)
+            printf("[DySO %u] Rows moved in: %lu, out: %lu, stray msgs: %lu\n", dyso_index_,
+                   worker.getMigratedIn(), worker.getMigratedOut(), worker.getStrayMsg());
+#endif
+#if (DYSO_NODE_ON_DEMAND == 1)
+            printf("[DySO %u] On-demand nodes: %lu (registered: %lu, rejected: %lu, unrecoverable: %lu)\n", dyso_index_,
+                   worker.getNumNodes(), worker.getRegistered(), worker.getRejected(), worker.getUnrecoverable());
+#endif
+            total_number_of_msgs = 0;
+            total_elapsed_time = 0;
+        }
+        /*-------------------*/
+
+#if (DYSO_CHECKPOINT_PERIOD_SEC > 0)
+        // (4) background checkpoint for a warm restart (skipped if the previous one is still being written)
+        if (!inProcess && start_ts_per_batch - last_checkpoint_ts >= std::chrono::seconds(DYSO_CHECKPOINT_PERIOD_SEC)) {
+            last_checkpoint_ts = start_ts_per_batch;
+            if (!worker.checkpointAsync(checkpointPath))
+                printf("[DySO %u] Skip checkpoint (previous one in progress)\n", dyso_index_);
+        }
+#endif
+    }
+}
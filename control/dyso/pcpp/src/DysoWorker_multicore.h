@@ -0,0 +1,700 @@
+#pragma once
+
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <unordered_map>
+#include <vector>
+
+#include "Checkpoint_multicore.h"
+#include "KeyMap_multicore.h"
+#include "KeyRecovery_multicore.h"
+#include "dyso_multicore.hpp"
+#include "timer_wheel.h"
+
+/**
+ * One DySO worker (i.e., one core) digesting the messages from the StatWorkerThread.
+ *
+ * It owns the main policies of the rows assigned to this core (getReplicaThreadIdx) in a dense table
+ * indexed by local row id (getLocalRowIdx), the up/down replicas used for self-tuning the aging period,
+ * the virtual queues of replicas, and one TX queue shared by all its policies.
+ * The message format is the one created at StatWorkerThread:
+ *  -- ACK     : (index_update << 32) + MSG_MASK_UPDATE_FLAG, index_update : (sequence << UPDATE_SEQ_SHIFT) | dysoIdx
+ *  -- Signature : (dysoIdx << 32) + 26-bit hashkey
+ *  -- Control : MSG_MASK_CTRL_FLAG + ..., markers of a row moving between workers (see createCtrlMsg)
+ *
+ * Rows other than replica ones may move to another worker at run time (see Rebalancer_multicore.h).
+ * Once every stat thread has switched a row to the new worker (MIGRATE_OUT from each), the old worker writes
+ * the state of the row to a file (exportRow), and the new worker buffers the msgs of the row until it loads the file
+ * (importMigratedRows). Slots of rows moved in are appended to dyso_, and slots of rows moved out are kept empty.
+ *
+ * It is shared by the shared-memory worker process (dyso_multicore.cpp)
+ * and the offline trace-replay harness (dyso_replay.cpp).
+ */
+class DysoWorker {
+   private:
+    const uint32_t workerIdx_;  // index of this DySO worker (core)
+    uint32_t agingPeriod_;      // global aging period (to be adjusted)
+
+    /* per-worker slabs and indexes of nodes (main policies, up/down replicas) */
+    NodePool nodePool_;
+    NodePool nodePoolUp_;
+    NodePool nodePoolDown_;
+    NodeIndex nodeIndex_;
+    NodeIndex nodeIndexUp_;
+    NodeIndex nodeIndexDown_;
+
+    /* SPSC queue to DPDK TX Worker */
+    qTxSPSC* updateQueue_ = nullptr;
+
+    /* policies (dyso_ : only rows of this core, by local row id, then rows moved in) */
+    std::vector<Dyso> dyso_;
+    std::vector<Dyso> dysoReplicaUp_;
+    std::vector<Dyso> dysoReplicaDown_;
+
+    /* states of message processing */
+    uint64_t nCtrlPktRx_ = 0;
+    uint32_t virtualQueueUp_ = 0;
+    uint32_t virtualQueueDown_ = 0;
+    uint64_t clockCycle_ = 0;
+    std::chrono::steady_clock::time_point start_ = std::chrono::steady_clock::now();
+
+    /* virtual hit/miss of main policies (cache status when a signature arrives) */
+    uint64_t nSigHit_ = 0;
+    uint64_t nSigMiss_ = 0;
+
+    /* on-demand registration of unknown keys (see DYSO_NODE_ON_DEMAND) */
+    const bool onDemand_;
+    AdmissionFilter admission_;
+    KeyRecovery keyRecovery_;
+    uint64_t nRegistered_ = 0;     // keys registered
+    uint64_t nRejected_ = 0;       // keys admitted, but rows are full of hot nodes
+    uint64_t nUnrecoverable_ = 0;  // signatures not from any 4-byte key
+
+    /* deadlines of UPDATEs in flight, by local row (see expireUpdates) */
+    static_assert(UPDATE_TIMEOUT < 64, "UPDATE_TIMEOUT must be shorter than the timer wheel");
+    TimerWheel<64> updateTimer_;
+    std::vector<uint64_t> updateDeadline_;
+    uint32_t nMsgTick_ = 0;         // messages in the current tick
+    uint64_t nUpdateInFlight_ = 0;  // policies with an UPDATE in flight
+
+    /* child process writing a checkpoint (see checkpointAsync) */
+    pid_t checkpointPid_ = -1;
+
+    /* rows of this worker, dysoIdx -> slot of dyso_ (LOCAL_ROW_AWAY bit : moved out, LOCAL_ROW_NONE : never here) */
+    static constexpr uint32_t LOCAL_ROW_AWAY = 0x80000000;
+    static constexpr uint32_t LOCAL_ROW_NONE = 0xFFFFFFFF;
+    std::vector<uint32_t> localRow_;
+    uint32_t nDefaultRows_ = 0;                                         // slots of rows by dysoRowMap (to checkpoint)
+    std::unordered_map<uint32_t, uint32_t> migrateOut_;                 // dysoIdx -> MIGRATE_OUT msgs received
+    std::unordered_map<uint32_t, std::vector<uint64_t>> migrateIn_;     // dysoIdx -> msgs buffered until imported
+    uint64_t nMigratedIn_ = 0;
+    uint64_t nMigratedOut_ = 0;
+    uint64_t nStrayMsg_ = 0;  // msgs of rows not in this worker (dropped)
+
+   public:
+    DysoWorker(const uint32_t& workerIdx, const uint32_t& agingPeriod, const bool& onDemand = false)
+        : workerIdx_(workerIdx), agingPeriod_(agingPeriod), onDemand_(onDemand) {
+        // load shared-memory queue
+        updateQueue_ = getTxQueue(std::to_string(workerIdx_));
+        if (updateQueue_ == nullptr) {
+            std::cerr << "[DysoWorker] Failed to open qTxSPSC of idx -" << workerIdx_ << std::endl;
+            exit(1);
+        }
+
+        // REG_LEN_KEY : number of rows (or dyso policies), of which ones assigned by dysoRowMap are for this core
+        dyso_.reserve(dysoRowMap.getNumRows(workerIdx_));
+        localRow_.assign(REG_LEN_KEY, LOCAL_ROW_NONE);
+        for (uint32_t idx = 0; idx < REG_LEN_KEY; idx++) {
+            if (getReplicaThreadIdx(idx) != workerIdx_)
+                continue;
+            assert(getLocalRowIdx(idx) == dyso_.size());
+            localRow_[idx] = getLocalRowIdx(idx);
+            dyso_.emplace_back(Dyso(idx, agingPeriod_, nodePool_, nodeIndex_, updateQueue_));
+            // create replicas
+            if (checkReplica(idx, workerIdx_)) {
+                auto replicaDysoIdx = getReplicaDysoIdx(idx);
+                dysoReplicaUp_.emplace_back(Dyso(replicaDysoIdx, agingPeriod_ * 2, nodePoolUp_, nodeIndexUp_));
+                dysoReplicaDown_.emplace_back(Dyso(replicaDysoIdx, std::max(agingPeriod_ / 2, uint32_t(1)), nodePoolDown_, nodeIndexDown_));
+            }
+        }
+        nDefaultRows_ = dyso_.size();
+        if (onDemand_)
+            admission_.init(dyso_.size());
+        updateDeadline_.assign(dyso_.size(), 0);
+    }
+    ~DysoWorker() {}
+
+    // policies refer to the node pools of this object
+    DysoWorker(const DysoWorker&) = delete;
+    DysoWorker& operator=(const DysoWorker&) = delete;
+
+    /**
+     * pre-install all 4B keys (host-endian) in ranges of [begin, end) whose rows are associated to this core.
+     * Keys are grouped by rows first, so that the node pools and indexes are allocated in bulk and nodes of a row are contiguous.
+     */
+    void addDefaultNodes(const std::vector<std::pair<uint64_t, uint64_t>>& ranges) {
+        // (1) collect (dysoIdx, (key, hashkey)) of this core, hashing keys in batch
+        std::vector<std::pair<uint32_t, KeyMapEntry>> rowKeys;
+        uint32_t netSrcIPs[4096], mpeg[4096], sw[4096];
+        for (const auto& range : ranges) {
+            for (uint64_t srcIP = range.first; srcIP < range.second;) {
+                uint32_t n = uint32_t(std::min(range.second - srcIP, uint64_t(4096)));
+                for (uint32_t i = 0; i < n; i++)
+                    netSrcIPs[i] = htonl(uint32_t(srcIP + i));  // change byte orders
+                crc32Batch(netSrcIPs, n, mpeg, sw);
+                srcIP += n;
+
+                for (uint32_t i = 0; i < n; i++) {
+                    uint32_t idx = mpeg[i] % REG_LEN_KEY;  // get dyso's index
+                    // check the flow is associated to this core
+                    if (getReplicaThreadIdx(idx) == workerIdx_)
+                        rowKeys.push_back({idx, {netSrcIPs[i], sw[i] & REG_MASK_GET_HASHKEY}});
+                }
+            }
+        }
+
+        // (2) group by rows (counting sort, stable)
+        std::vector<uint32_t> rowOffset(REG_LEN_KEY + 1, 0);
+        uint64_t nReplicaKeys = 0;
+        for (const auto& rowKey : rowKeys) {
+            rowOffset[rowKey.first + 1]++;
+            nReplicaKeys += checkReplica(rowKey.first, workerIdx_) ? 1 : 0;
+        }
+        for (uint32_t idx = 0; idx < REG_LEN_KEY; idx++)
+            rowOffset[idx + 1] += rowOffset[idx];
+        std::vector<KeyMapEntry> sortedKeys(rowKeys.size());
+        for (const auto& rowKey : rowKeys)
+            sortedKeys[rowOffset[rowKey.first]++] = rowKey.second;  // rowOffset[idx] -> end of row idx
+        rowKeys.clear();
+        rowKeys.shrink_to_fit();
+
+        // (3) bulk allocation, then insert row by row
+        nodePool_.reserve(nodePool_.size() + sortedKeys.size());
+        nodePoolUp_.reserve(nodePoolUp_.size() + nReplicaKeys);
+        nodePoolDown_.reserve(nodePoolDown_.size() + nReplicaKeys);
+        nodeIndex_.reserve(nodeIndex_.size() + sortedKeys.size());
+        nodeIndexUp_.reserve(nodeIndexUp_.size() + nReplicaKeys);
+        nodeIndexDown_.reserve(nodeIndexDown_.size() + nReplicaKeys);
+        uint32_t begin = 0;
+        for (uint32_t idx = 0; idx < REG_LEN_KEY; idx++) {
+            for (uint32_t i = begin; i < rowOffset[idx]; i++) {
+                dyso_[getLocalRowIdx(idx)].addDefaultNode(sortedKeys[i].key, sortedKeys[i].hashkey);  // insert
+
+                // insert to replicas
+                if (checkReplica(idx, workerIdx_)) {
+                    uint32_t replicaDysoIdx = getReplicaDysoIdx(idx);
+                    dysoReplicaUp_[replicaDysoIdx].addDefaultNode(sortedKeys[i].key, sortedKeys[i].hashkey);
+                    dysoReplicaDown_[replicaDysoIdx].addDefaultNode(sortedKeys[i].key, sortedKeys[i].hashkey);
+                }
+            }
+            begin = rowOffset[idx];
+        }
+    }
+
+    /**
+     * pre-install the keys of rows associated to this core from the published keymap (see KeyMap_multicore.h).
+     * The same nodes and order as addDefaultNodes(ranges), but only copying the rows of this core.
+     */
+    void addDefaultNodes(const KeyMap& keymap) {
+        uint64_t nKeys = 0, nReplicaKeys = 0;
+        for (uint32_t idx = 0; idx < REG_LEN_KEY; idx++) {
+            if (getReplicaThreadIdx(idx) != workerIdx_)
+                continue;
+            uint64_t nRowKeys = keymap.rowEnd(idx) - keymap.rowBegin(idx);
+            nKeys += nRowKeys;
+            nReplicaKeys += checkReplica(idx, workerIdx_) ? nRowKeys : 0;
+        }
+        nodePool_.reserve(nodePool_.size() + nKeys);
+        nodePoolUp_.reserve(nodePoolUp_.size() + nReplicaKeys);
+        nodePoolDown_.reserve(nodePoolDown_.size() + nReplicaKeys);
+        nodeIndex_.reserve(nodeIndex_.size() + nKeys);
+        nodeIndexUp_.reserve(nodeIndexUp_.size() + nReplicaKeys);
+        nodeIndexDown_.reserve(nodeIndexDown_.size() + nReplicaKeys);
+
+        for (uint32_t idx = 0; idx < REG_LEN_KEY; idx++) {
+            if (getReplicaThreadIdx(idx) != workerIdx_)
+                continue;
+            Dyso& policy = dyso_[getLocalRowIdx(idx)];
+            for (uint64_t i = keymap.rowBegin(idx); i < keymap.rowEnd(idx); i++)
+                policy.addDefaultNode(keymap[i].key, keymap[i].hashkey);
+
+            if (checkReplica(idx, workerIdx_)) {
+                uint32_t replicaDysoIdx = getReplicaDysoIdx(idx);
+                for (uint64_t i = keymap.rowBegin(idx); i < keymap.rowEnd(idx); i++) {
+                    dysoReplicaUp_[replicaDysoIdx].addDefaultNode(keymap[i].key, keymap[i].hashkey);
+                    dysoReplicaDown_[replicaDysoIdx].addDefaultNode(keymap[i].key, keymap[i].hashkey);
+                }
+            }
+        }
+    }
+
+    /**
+     * move the nodes installed so far to the static part of indexes (minimal perfect hash).
+     * Nodes registered afterwards still go to the dynamic part.
+     */
+    bool buildPerfectHash() {
+        return nodeIndex_.buildPerfectHash() && nodeIndexUp_.buildPerfectHash() && nodeIndexDown_.buildPerfectHash();
+    }
+
+    /* digest one message from the StatWorkerThread */
+    void processMsg(const uint64_t& msg) {
+        uint32_t hashkey, dysoIdx;
+        if ((msg & (MSG_MASK_UPDATE_FLAG | MSG_MASK_CTRL_FLAG)) == MSG_MASK_CTRL_FLAG) {
+            processCtrlMsg(msg);
+            return;
+        }
+        dysoIdx = uint32_t((msg & ~MSG_MASK_UPDATE_FLAG) >> 32) & (REG_LEN_KEY - 1);
+        const uint32_t localRowIdx = localRow_[dysoIdx];
+        if (localRowIdx >= LOCAL_ROW_AWAY) {
+            deferMsg(dysoIdx, msg);  // row is moving in (or not of this worker)
+            return;
+        }
+        clockCycle_++;
+        if (++nMsgTick_ == UPDATE_TIMEOUT_TICK) {
+            nMsgTick_ = 0;
+            expireUpdates();
+        }
+
+        // update msg
+        if ((msg & MSG_MASK_UPDATE_FLAG) == MSG_MASK_UPDATE_FLAG) {
+            nCtrlPktRx_++;
+            // need to manage the virtual queues for replicas by hand.
+            // the dequeu speed is 1/256 slower than main policy's TXqueue
+            // because 4 DySO workers x 1/64 replica ratio
+            if (nCtrlPktRx_ % REG_LEN_REC == 0) {
+                virtualQueueUp_ = (virtualQueueUp_ == 0) ? 0 : virtualQueueUp_ - 1;
+                virtualQueueDown_ = (virtualQueueDown_ == 0) ? 0 : virtualQueueDown_ - 1;
+            }
+            if (dyso_[localRowIdx].moveUpdateToActive(getAckSeq(msg)))
+                nUpdateInFlight_--;  // not a stale ACK
+#if (DYSODEBUG == 2)
+            printf("[%u INFO] Get ACK of DysoIdx: %u\n", workerIdx_, dysoIdx);
+#endif
+        }
+        // packet signatures (hash values for monitoring)
+        else {
+#if (DYSODEBUG == 2)
+            if (clockCycle_ % (1 << 23) == 0) {
+                auto end = std::chrono::steady_clock::now();
+                auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start_).count();
+                printf("[%u INFO] Avg to process 1 msgs: %lu (ns)\n", workerIdx_, uint64_t(elapsed) / clockCycle_);
+                start_ = end;
+            }
+#endif
+            // parse the message and feed to the corresponding policy (dysoIdx)
+            hashkey = uint32_t(msg & MSG_MASK_GET_KEY);
+            Dyso& policy = dyso_[localRowIdx];
+            bool inFlight = policy.isUpdateInProgress();
+            if (!onDemand_) {
+                policy.updatePolicyStat(hashkey) ? ++nSigHit_ : ++nSigMiss_;
+            } else {
+                NodeHandle node = policy.findNode(hashkey);
+                if (node == NODE_NULL)
+                    node = registerOnDemand(dysoIdx, localRowIdx, hashkey);
+                bool hit = (node != NODE_NULL) ? policy.updatePolicyStatNode(node) : policy.updatePolicyStat(hashkey);
+                hit ? ++nSigHit_ : ++nSigMiss_;
+            }
+            if (!inFlight && policy.isUpdateInProgress()) {
+                updateDeadline_[localRowIdx] = updateTimer_.schedule(localRowIdx, UPDATE_TIMEOUT);  // UPDATE is issued
+                nUpdateInFlight_++;
+            }
+#if (DYSODEBUG == 2)
+            printf("[%u INFO] Get Signature of DysoIdx: %u, hashkey: %u\n", workerIdx_, dysoIdx, hashkey);
+#endif
+
+            // process for replicas
+            if (checkReplica(dysoIdx, workerIdx_)) {
+                uint32_t replicaDysoIdx = getReplicaDysoIdx(dysoIdx);
+                dysoReplicaUp_[replicaDysoIdx].updatePolicyStatReplica(hashkey, virtualQueueUp_);
+                dysoReplicaDown_[replicaDysoIdx].updatePolicyStatReplica(hashkey, virtualQueueDown_);
+            }
+
+            // do aging (every 2M msgs ~ 1 second if control packet rate is 1Mpps)
+            if (clockCycle_ > 2097152) {
+                // initialize a wall-clock
+                clockCycle_ = 0;
+                start_ = std::chrono::steady_clock::now();
+                selfTuneAgingPeriod();
+            }
+        }
+    }
+
+    /**
+     * next tick of the UPDATE timer : UPDATEs whose ACK has not arrived by their deadline
+     * are retransmitted or rolled back (see Dyso::onUpdateTimeout).
+     * Entries of rows already ACKed (or re-issued with a later deadline) are skipped.
+     */
+    void expireUpdates() {
+        updateTimer_.advance([&](const uint32_t& localRowIdx, const uint64_t& deadline) {
+            Dyso& policy = dyso_[localRowIdx];
+            if (!policy.isUpdateInProgress() || updateDeadline_[localRowIdx] != deadline)
+                return;
+            if (policy.onUpdateTimeout())
+                updateDeadline_[localRowIdx] = updateTimer_.schedule(localRowIdx, UPDATE_TIMEOUT);
+            else
+                nUpdateInFlight_--;  // rolled back
+        });
+    }
+
+    /**
+     * register the key of an unknown signature once admitted, to the main policy and its replicas.
+     * The key is recovered from (dysoIdx, hashkey) itself, so no key space is kept in memory.
+     * Return the node of the main policy (NODE_NULL if not registered).
+     */
+    NodeHandle registerOnDemand(const uint32_t& dysoIdx, const uint32_t& localRowIdx, const uint32_t& hashkey) {
+        if (!admission_.admit(localRowIdx, hashkey))
+            return NODE_NULL;
+        uint32_t netKey;
+        if (!keyRecovery_.recover(dysoIdx, hashkey, netKey)) {
+            ++nUnrecoverable_;
+            return NODE_NULL;
+        }
+        NodeHandle node = dyso_[localRowIdx].registerNode(netKey, hashkey, ON_DEMAND_MAX_NODE_PER_ROW);
+        if (node == NODE_NULL) {
+            ++nRejected_;
+            return NODE_NULL;
+        }
+        ++nRegistered_;
+
+        if (checkReplica(dysoIdx, workerIdx_)) {
+            uint32_t replicaDysoIdx = getReplicaDysoIdx(dysoIdx);
+            dysoReplicaUp_[replicaDysoIdx].registerNode(netKey, hashkey, ON_DEMAND_MAX_NODE_PER_ROW);
+            dysoReplicaDown_[replicaDysoIdx].registerNode(netKey, hashkey, ON_DEMAND_MAX_NODE_PER_ROW);
+        }
+        return node;
+    }
+
+    /**
+     * markers of a row moving between workers, in order with the other msgs of the same stat thread.
+     * MIGRATE_OUT : the row is exported once all stat threads have sent it (no more msgs of the row to come here).
+     * MIGRATE_IN  : msgs of the row are buffered from now on until it is imported.
+     * A MIGRATE_OUT of a row still moving in is buffered too, so it is handled after the import.
+     */
+    void processCtrlMsg(const uint64_t& msg) {
+        uint32_t op, dysoIdx, arg;
+        parseCtrlMsg(msg, op, dysoIdx, arg);
+        dysoIdx &= (REG_LEN_KEY - 1);
+        if (op == MSG_CTRL_MIGRATE_IN) {
+            if (localRow_[dysoIdx] >= LOCAL_ROW_AWAY)
+                migrateIn_[dysoIdx];  // start buffering (no-op for the markers of other stat threads)
+            return;
+        }
+        if (op != MSG_CTRL_MIGRATE_OUT || arg >= getNumDysoWorker()) {
+            std::cerr << "[DysoWorker " << workerIdx_ << "] Unknown control msg " << std::hex << msg << std::dec << std::endl;
+            return;
+        }
+        if (localRow_[dysoIdx] >= LOCAL_ROW_AWAY) {
+            deferMsg(dysoIdx, msg);
+            return;
+        }
+        if (++migrateOut_[dysoIdx] < nCoreForStat)
+            return;
+        migrateOut_.erase(dysoIdx);
+        if (!exportRow(dysoIdx, arg)) {
+            std::cerr << "[DysoWorker " << workerIdx_ << "] Failed to export Dyso " << dysoIdx << " to worker " << arg << std::endl;
+            exit(1);  // the new worker would wait for it forever
+        }
+    }
+
+    /* buffer a msg of a row moving in, or drop it */
+    void deferMsg(const uint32_t& dysoIdx, const uint64_t& msg) {
+        auto it = migrateIn_.find(dysoIdx);
+        if (it == migrateIn_.end()) {
+            ++nStrayMsg_;
+            return;
+        }
+        it->second.push_back(msg);
+    }
+
+    /**
+     * write the state of a row (with its UPDATE in flight) to the migration file for worker to, and release it here.
+     * The file is published at once by rename, so the new worker never reads a partial one.
+     */
+    bool exportRow(const uint32_t& dysoIdx, const uint32_t& to) {
+        const uint32_t localRowIdx = localRow_[dysoIdx];
+        Dyso& policy = dyso_[localRowIdx];
+        CheckpointWriter writer(getMigrationPath(dysoIdx));
+        CheckpointHeader header = {};
+        header.workerIdx = to;
+        header.regLenKey = REG_LEN_KEY;
+        header.nHead = N_HEAD;
+        header.stageCache = STAGE_CACHE;
+        header.numDysoWorker = getNumDysoWorker();
+        header.partition = dysoRowMap.getPartition();
+        header.agingPeriod = agingPeriod_;
+        header.nPolicies = 1;
+        header.nNodes = policy.getNumNodes();
+        policy.saveCheckpoint(writer);
+        if (!writer.commit(header))
+            return false;
+
+        nUpdateInFlight_ -= policy.isUpdateInProgress() ? 1 : 0;
+        policy.releaseAllNodes();
+        updateDeadline_[localRowIdx] = 0;
+        localRow_[dysoIdx] = localRowIdx | LOCAL_ROW_AWAY;
+        ++nMigratedOut_;
+#if (DYSODEBUG >= 1)
+        printf("[%u INFO] Moved Dyso %u to worker %u\n", workerIdx_, dysoIdx, to);
+#endif
+        return true;
+    }
+
+    /**
+     * load the rows moving in whose migration files are written, then digest their buffered msgs.
+     * A row takes its former slot if it has been here before, or a new slot (with the aging period of this worker).
+     */
+    void importMigratedRows() {
+        for (auto it = migrateIn_.begin(); it != migrateIn_.end();) {
+            const uint32_t dysoIdx = it->first;
+            const std::string path = getMigrationPath(dysoIdx);
+            CheckpointReader reader;
+            const CheckpointHeader* header = reader.open(path, workerIdx_);
+            if (header == nullptr || header->nPolicies != 1) {
+                ++it;  // not exported yet
+                continue;
+            }
+            const CheckpointRow* row = reader.read<CheckpointRow>(1);
+            const CheckpointNode* nodes = (row != nullptr) ? reader.read<CheckpointNode>(header->nNodes) : nullptr;
+            if (nodes == nullptr || row->idx != dysoIdx) {
+                std::cerr << "[DysoWorker " << workerIdx_ << "] Corrupted migration file " << path << std::endl;
+                exit(1);
+            }
+
+            uint32_t localRowIdx = localRow_[dysoIdx];
+            if (localRowIdx == LOCAL_ROW_NONE) {
+                localRowIdx = dyso_.size();
+                dyso_.emplace_back(Dyso(dysoIdx, agingPeriod_, nodePool_, nodeIndex_, updateQueue_));
+                updateDeadline_.push_back(0);
+                if (onDemand_)
+                    admission_.resize(dyso_.size());
+            } else {
+                localRowIdx &= ~LOCAL_ROW_AWAY;
+                if (onDemand_)
+                    admission_.reset(localRowIdx);
+            }
+            Dyso& policy = dyso_[localRowIdx];
+            nodePool_.reserve(nodePool_.size() + header->nNodes);
+            policy.loadCheckpoint(*row, nodes, true);
+            policy.adjustAgingPeriod(agingPeriod_);
+            if (policy.isUpdateInProgress()) {
+                updateDeadline_[localRowIdx] = updateTimer_.schedule(localRowIdx, UPDATE_TIMEOUT);
+                nUpdateInFlight_++;
+            }
+            localRow_[dysoIdx] = localRowIdx;
+            unlink(path.c_str());
+            ++nMigratedIn_;
+
+            std::vector<uint64_t> msgs = std::move(it->second);
+            it = migrateIn_.erase(it);
+            for (const auto& msg : msgs)
+                processMsg(msg);  // may buffer msgs of other rows moving in (not this one)
+        }
+    }
+
+    /**
+     * write the policy state (nodes of all heads, counts, cache flags, aging periods) of this worker to path.
+     * The file is published at once by rename (see Checkpoint_multicore.h).
+     * Only rows by dysoRowMap are recorded (empty if moved out), i.e., rows moved in restart empty at their own worker.
+     */
+    bool saveCheckpoint(const std::string& path) const {
+        CheckpointWriter writer(path);
+        CheckpointHeader header = {};
+        header.workerIdx = workerIdx_;
+        header.regLenKey = REG_LEN_KEY;
+        header.nHead = N_HEAD;
+        header.stageCache = STAGE_CACHE;
+        header.numDysoWorker = getNumDysoWorker();
+        header.partition = dysoRowMap.getPartition();
+        header.agingPeriod = agingPeriod_;
+        header.virtualQueueUp = virtualQueueUp_;
+        header.virtualQueueDown = virtualQueueDown_;
+        header.clockCycle = clockCycle_;
+        header.nCtrlPktRx = nCtrlPktRx_;
+        header.nPolicies = nDefaultRows_;
+        header.nReplicas = dysoReplicaUp_.size();
+        for (uint32_t i = 0; i < nDefaultRows_; i++) {
+            header.nNodes += dyso_[i].getNumNodes();
+            dyso_[i].saveCheckpoint(writer);
+        }
+        for (const auto& replica : dysoReplicaUp_) {
+            header.nReplicaNodesUp += replica.getNumNodes();
+            replica.saveCheckpoint(writer);
+        }
+        for (const auto& replica : dysoReplicaDown_) {
+            header.nReplicaNodesDown += replica.getNumNodes();
+            replica.saveCheckpoint(writer);
+        }
+        return writer.commit(header);
+    }
+
+    /**
+     * checkpoint in background : a forked child writes the copy-on-write snapshot of this process,
+     * so the worker only pays for fork() and the pages it modifies meanwhile.
+     * Return false if the previous checkpoint is still being written (or fork fails).
+     */
+    bool checkpointAsync(const std::string& path) {
+        if (checkpointPid_ > 0) {
+            if (waitpid(checkpointPid_, nullptr, WNOHANG) == 0)
+                return false;
+            checkpointPid_ = -1;
+        }
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid < 0)
+            return false;
+        if (pid == 0)
+            _exit(saveCheckpoint(path) ? 0 : 1);  // child : no destructors, no flush of parent's buffers
+        checkpointPid_ = pid;
+        return true;
+    }
+
+    /* wait for the background checkpoint, return true if it was written */
+    bool waitCheckpoint() {
+        if (checkpointPid_ <= 0)
+            return false;
+        int status = 0;
+        bool ok = waitpid(checkpointPid_, &status, 0) == checkpointPid_ && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        checkpointPid_ = -1;
+        return ok;
+    }
+
+    /**
+     * restore the policy state from the checkpoint at path, instead of installing nodes (all policies must be empty).
+     * Return false if it does not exist or is written with other configurations.
+     */
+    bool restoreCheckpoint(const std::string& path) {
+        CheckpointReader reader;
+        const CheckpointHeader* header = reader.open(path, workerIdx_);
+        if (header == nullptr || header->nPolicies != dyso_.size() || header->nReplicas != dysoReplicaUp_.size())
+            return false;
+
+        agingPeriod_ = header->agingPeriod;
+        virtualQueueUp_ = header->virtualQueueUp;
+        virtualQueueDown_ = header->virtualQueueDown;
+        clockCycle_ = header->clockCycle;
+        nCtrlPktRx_ = header->nCtrlPktRx;
+        nodePool_.reserve(nodePool_.size() + header->nNodes);
+        nodePoolUp_.reserve(nodePoolUp_.size() + header->nReplicaNodesUp);
+        nodePoolDown_.reserve(nodePoolDown_.size() + header->nReplicaNodesDown);
+        nodeIndex_.reserve(nodeIndex_.size() + header->nNodes);
+        nodeIndexUp_.reserve(nodeIndexUp_.size() + header->nReplicaNodesUp);
+        nodeIndexDown_.reserve(nodeIndexDown_.size() + header->nReplicaNodesDown);
+
+        auto loadRows = [&](std::vector<Dyso>& policies) {
+            for (auto& policy : policies) {
+                const CheckpointRow* row = reader.read<CheckpointRow>(1);
+                uint64_t nNodes = 0;
+                for (uint32_t i = 0; row != nullptr && i <= N_HEAD; i++)
+                    nNodes += row->nNodes[i];
+                const CheckpointNode* nodes = (row != nullptr) ? reader.read<CheckpointNode>(nNodes) : nullptr;
+                if (nodes == nullptr || row->idx != policy.getDysoIdx()) {
+                    std::cerr << "[DysoWorker] Corrupted checkpoint " << path << " at Dyso " << policy.getDysoIdx() << std::endl;
+                    exit(1);
+                }
+                policy.loadCheckpoint(*row, nodes);
+            }
+        };
+        loadRows(dyso_);
+        loadRows(dysoReplicaUp_);
+        loadRows(dysoReplicaDown_);
+        return true;
+    }
+
+    /* self-tuning aging period with up/down replicas */
+    void selfTuneAgingPeriod() {
+        double hitRatioUp = 0.0, hitRatioDown = 0.0;
+        for (auto& replica : dysoReplicaUp_)
+            hitRatioUp += replica.getHitRate();
+        for (auto& replica : dysoReplicaDown_)
+            hitRatioDown += replica.getHitRate();
+
+        // for sanity, we bound the aging period
+        agingPeriod_ = (hitRatioUp >= hitRatioDown) ? agingPeriod_ * 2 : std::max(agingPeriod_ / 2, uint32_t(1));
+        agingPeriod_ = (agingPeriod_ > 1024) ? 32 : agingPeriod_;
+#if (DYSODEBUG >= 1)
+        printf("\t[%u Aging] Self-tuning: HitRatio Up(%0.4f), down(%0.4f) -> selected: %u\n",
+               workerIdx_, hitRatioUp / dysoReplicaUp_.size(), hitRatioDown / dysoReplicaDown_.size(), agingPeriod_);
+#endif
+        // reconfigure all repllicas
+        for (auto& replica : dysoReplicaUp_)
+            replica.initAllReplica(agingPeriod_ << 1);
+        for (auto& replica : dysoReplicaDown_)
+            replica.initAllReplica(std::max(agingPeriod_ >> 1, uint32_t(1)));
+
+        // reconfigure main policies
+        for (auto& policy : dyso_)
+            policy.adjustAgingPeriod(agingPeriod_);
+    }
+
+    /* Accessor */
+    uint32_t getWorkerIdx() const { return workerIdx_; }
+    uint32_t getAgingPeriod() const { return agingPeriod_; }
+    size_t getNumPolicies() const { return dyso_.size(); }
+    uint32_t getNumRows() const { return uint32_t(nDefaultRows_ + nMigratedIn_ - nMigratedOut_); }  // owned now
+    uint64_t getNumUpdateInFlight() const { return nUpdateInFlight_; }
+    double getReplicaHitRatio(const bool& up) const {
+        const std::vector<Dyso>& replicas = up ? dysoReplicaUp_ : dysoReplicaDown_;
+        uint32_t n = 0;
+        double hitRatio = 0.0;
+        for (const auto& replica : replicas) {
+            double rate = replica.getHitRate();
+            if (rate == rate) {  // not NaN (no packet since reset)
+                hitRatio += rate;
+                n++;
+            }
+        }
+        return (n > 0) ? hitRatio / n : 0.0;
+    }
+    bool hasPendingMigration() const { return !migrateIn_.empty(); }
+    uint64_t getMigratedIn() const { return nMigratedIn_; }
+    uint64_t getMigratedOut() const { return nMigratedOut_; }
+    uint64_t getStrayMsg() const { return nStrayMsg_; }
+    size_t getNumReplicas() const { return dysoReplicaUp_.size(); }
+    uint64_t getSigHit() const { return nSigHit_; }
+    uint64_t getSigMiss() const { return nSigMiss_; }
+    uint64_t getUnknownKey() const {
+        uint64_t unknownKey = 0;
+        for (const auto& policy : dyso_)
+            unknownKey += policy.getUnknownKey();
+        return unknownKey;
+    }
+    const NodeIndex& getNodeIndex() const { return nodeIndex_; }
+    bool isOnDemand() const { return onDemand_; }
+    uint64_t getNumNodes() const {
+        uint64_t nNodes = 0;
+        for (const auto& policy : dyso_)
+            nNodes += policy.getNumNodes();
+        return nNodes;
+    }
+    uint64_t getUpdateTimeout() const {
+        uint64_t n = 0;
+        for (const auto& policy : dyso_)
+            n += policy.getTimeout();
+        return n;
+    }
+    uint64_t getUpdateRetransmit() const {
+        uint64_t n = 0;
+        for (const auto& policy : dyso_)
+            n += policy.getRetransmit();
+        return n;
+    }
+    uint64_t getUpdateRollback() const {
+        uint64_t n = 0;
+        for (const auto& policy : dyso_)
+            n += policy.getRollback();
+        return n;
+    }
+    uint64_t getStaleAck() const {
+        uint64_t n = 0;
+        for (const auto& policy : dyso_)
+            n += policy.getStaleAck();
+        return n;
+    }
+    uint64_t getRegistered() const { return nRegistered_; }
+    uint64_t getRejected() const { return nRejected_; }
+    uint64_t getUnrecoverable() const { return nUnrecoverable_; }
+};
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <arpa/inet.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "crc32_batch.h"
+#include "utils_macro_multicore.h"
+
+/**
+ * Key -> (row, hashkey) assignment of the pre-installed keys, shared by all DySO workers.
+ *
+ * The builder (dyso_keymap.cpp) computes crc32_mpeg (row) and crc32 (hashkey) of every key once with multiple
+ * threads, and publishes the entries grouped by rows (keys are ascending in a row) in a shared-memory segment.
+ * Each worker attaches it read-only and bulk-loads the rows it owns (getReplicaThreadIdx),
+ * instead of hashing all ~16.7M keys by itself.
+ *
+ * Layout : KeyMapHeader | KeyMapEntry[nKeys]
+ */
+#define KEYMAP_SHM_NAME "/shm_dyso_keymap"
+constexpr uint64_t KEYMAP_MAGIC = 0x44594B45594D4150;  // "DYKEYMAP"
+constexpr uint32_t KEYMAP_VERSION = 1;
+constexpr uint32_t KEYMAP_MAX_RANGE = 8;
+
+typedef std::vector<std::pair<uint64_t, uint64_t>> KeyRanges;  // [begin, end) of host-endian keys
+
+/* pre-installed keys of the simulation, [0, 5M) and [4085M, 4096M) */
+inline KeyRanges getDefaultKeyRanges() {
+    const uint64_t upperSrcIP = (uint64_t(5) << 20);     // [0, 5M)
+    const uint64_t lowerSrcIP = (uint64_t(4085) << 20);  // [4085M, 4096M)
+    return {{0, upperSrcIP}, {lowerSrcIP, uint64_t(UINT32_MAX) + 1}};
+}
+
+struct KeyMapHeader {
+    std::atomic<uint64_t> magic;  // KEYMAP_MAGIC once published
+    uint32_t version;
+    uint32_t regLenKey;
+    uint64_t nKeys;
+    uint64_t nRanges;
+    uint64_t ranges[KEYMAP_MAX_RANGE][2];
+    uint64_t rowOffset[REG_LEN_KEY + 1];  // entries of row idx : [rowOffset[idx], rowOffset[idx + 1])
+};
+
+struct KeyMapEntry {
+    uint32_t key;      // Big-Endian (Network)
+    uint32_t hashkey;  // 26-bit hashkey
+};
+
+class KeyMap {
+   private:
+    const KeyMapHeader* header_ = nullptr;
+    const KeyMapEntry* entries_ = nullptr;
+    size_t len_ = 0;
+
+   public:
+    KeyMap() {}
+    ~KeyMap() {
+        if (header_ != nullptr)
+            munmap((void*)header_, len_);
+    }
+    KeyMap(const KeyMap&) = delete;
+    KeyMap& operator=(const KeyMap&) = delete;
+
+    /* attach the published keymap, return false if not exist or built for other key ranges */
+    bool attach(const KeyRanges& ranges, const char* name = KEYMAP_SHM_NAME) {
+        size_t len = 0;
+        const KeyMapHeader* header = (const KeyMapHeader*)shm_attach(name, len);
+        if (header == nullptr)
+            return false;
+
+        bool valid = len >= sizeof(KeyMapHeader) && header->magic.load(std::memory_order_acquire) == KEYMAP_MAGIC &&
+                     header->version == KEYMAP_VERSION && header->regLenKey == REG_LEN_KEY &&
+                     len >= sizeof(KeyMapHeader) + header->nKeys * sizeof(KeyMapEntry) && header->nRanges == ranges.size();
+        for (size_t i = 0; valid && i < ranges.size(); i++)
+            valid = header->ranges[i][0] == ranges[i].first && header->ranges[i][1] == ranges[i].second;
+        if (!valid) {
+            munmap((void*)header, len);
+            return false;
+        }
+        header_ = header;
+        entries_ = (const KeyMapEntry*)(header + 1);
+        len_ = len;
+        return true;
+    }
+
+    /* Accessor */
+    uint64_t size() const { return header_->nKeys; }
+    uint64_t rowBegin(const uint32_t& idx) const { return header_->rowOffset[idx]; }
+    uint64_t rowEnd(const uint32_t& idx) const { return header_->rowOffset[idx + 1]; }
+    const KeyMapEntry& operator[](const uint64_t& i) const { return entries_[i]; }
+
+    /**
+     * Build and publish the keymap with nThreads threads.
+     * (1) each thread hashes a contiguous chunk of keys and counts keys per row,
+     * (2) offsets are given per (row, thread), so that (3) threads scatter their keys in order without locks.
+     */
+    static bool build(const KeyRanges& ranges, uint32_t nThreads, const char* name = KEYMAP_SHM_NAME) {
+        if (ranges.size() > KEYMAP_MAX_RANGE) {
+            std::cerr << "[KeyMap] Too many key ranges: " << ranges.size() << std::endl;
+            return false;
+        }
+        std::vector<uint64_t> rangeStart(ranges.size() + 1, 0);  // keys before range i
+        for (size_t i = 0; i < ranges.size(); i++)
+            rangeStart[i + 1] = rangeStart[i] + (ranges[i].second - ranges[i].first);
+        const uint64_t nKeys = rangeStart.back();
+        nThreads = std::max(uint32_t(1), nThreads);
+
+        size_t len = sizeof(KeyMapHeader) + nKeys * sizeof(KeyMapEntry);
+        KeyMapHeader* header = (KeyMapHeader*)shm_create(name, len);
+        if (header == nullptr)
+            return false;
+        KeyMapEntry* entries = (KeyMapEntry*)(header + 1);
+
+        // i-th key (host-endian) of all ranges
+        auto getKey = [&](const uint64_t& i) {
+            size_t r = std::upper_bound(rangeStart.begin(), rangeStart.end(), i) - rangeStart.begin() - 1;
+            return uint32_t(ranges[r].first + (i - rangeStart[r]));
+        };
+
+        // (1) hash keys
+        std::vector<std::vector<uint16_t>> rows(nThreads);
+        std::vector<std::vector<uint32_t>> hashkeys(nThreads);
+        std::vector<std::vector<uint64_t>> counts(nThreads, std::vector<uint64_t>(REG_LEN_KEY, 0));
+        std::vector<std::thread> threads;
+        for (uint32_t t = 0; t < nThreads; t++) {
+            threads.emplace_back([&, t]() {
+                uint64_t begin = nKeys * t / nThreads, end = nKeys * (t + 1) / nThreads;
+                rows[t].resize(end - begin);
+                hashkeys[t].resize(end - begin);
+                uint32_t netSrcIPs[4096], mpeg[4096];
+                for (uint64_t i = begin; i < end;) {
+                    uint32_t n = uint32_t(std::min(end - i, uint64_t(4096)));
+                    for (uint32_t j = 0; j < n; j++)
+                        netSrcIPs[j] = htonl(getKey(i + j));
+                    crc32Batch(netSrcIPs, n, mpeg, &hashkeys[t][i - begin]);
+                    for (uint32_t j = 0; j < n; j++) {
+                        uint32_t idx = mpeg[j] % REG_LEN_KEY;
+                        rows[t][i - begin + j] = uint16_t(idx);
+                        hashkeys[t][i - begin + j] &= REG_MASK_GET_HASHKEY;
+                        counts[t][idx]++;
+                    }
+                    i += n;
+                }
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+        threads.clear();
+
+        // (2) offsets of (row, thread)
+        uint64_t offset = 0;
+        for (uint32_t idx = 0; idx < REG_LEN_KEY; idx++) {
+            header->rowOffset[idx] = offset;
+            for (uint32_t t = 0; t < nThreads; t++) {
+                uint64_t count = counts[t][idx];
+                counts[t][idx] = offset;  // -> write offset of thread t at row idx
+                offset += count;
+            }
+        }
+        header->rowOffset[REG_LEN_KEY] = offset;
+
+        // (3) scatter
+        for (uint32_t t = 0; t < nThreads; t++) {
+            threads.emplace_back([&, t]() {
+                uint64_t begin = nKeys * t / nThreads, end = nKeys * (t + 1) / nThreads;
+                for (uint64_t i = begin; i < end; i++) {
+                    entries[counts[t][rows[t][i - begin]]++] = {htonl(getKey(i)), hashkeys[t][i - begin]};
+                }
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+
+        // publish (magic at last)
+        header->version = KEYMAP_VERSION;
+        header->regLenKey = REG_LEN_KEY;
+        header->nKeys = nKeys;
+        header->nRanges = ranges.size();
+        for (size_t i = 0; i < ranges.size(); i++) {
+            header->ranges[i][0] = ranges[i].first;
+            header->ranges[i][1] = ranges[i].second;
+        }
+        header->magic.store(KEYMAP_MAGIC, std::memory_order_release);
+        munmap((void*)header, len);
+        return true;
+    }
+};
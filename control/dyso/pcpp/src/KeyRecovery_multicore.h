@@ -0,0 +1,73 @@
+#pragma once
+
+#include <arpa/inet.h>
+#include <stdio.h>
+
+#include "crc32.h"
+#include "crc32mpeg.h"
+#include "utils_macro_multicore.h"
+
+/**
+ * Recover the 4-byte key (IPv4 srcIP) of a signature, i.e., dysoIdx = crc32_mpeg[13:0] and hashkey = crc32[25:0].
+ *
+ * Both CRCs are affine over GF(2) in the bits of the key, and the 40 bits of a signature have rank 32 for 4-byte keys,
+ * so the key is given by eliminating the signature with a basis of signatures of single-bit keys.
+ * A non-zero residue means the signature is not from any 4-byte key (e.g., corrupted), which is rejected.
+ * It is used for on-demand registration (see DYSO_NODE_ON_DEMAND), where nodes need keys for UPDATEs.
+ */
+class KeyRecovery {
+   private:
+    static constexpr int KEY_BIT = 32;
+    uint64_t base_;                // signature of key 0 (affine part)
+    uint64_t basis_[KEY_BIT];      // linear part of signature, reduced (echelon in order)
+    uint32_t combo_[KEY_BIT];      // key bits composing basis_[i]
+    uint64_t pivot_[KEY_BIT];      // pivot bit of basis_[i]
+
+    /* 40-bit signature of host-endian key : hashkey (26 bits) << 14 | dysoIdx (14 bits) */
+    static uint64_t signatureOf(const uint32_t& key) {
+        uint32_t netKey = htonl(key);
+        return uint64_t(crc32_mpeg_u32(netKey) & REG_MASK_GET_DYSO_IDX) |
+               (uint64_t(crc32_sw_u32(netKey) & REG_MASK_GET_HASHKEY) << 14);
+    }
+
+   public:
+    KeyRecovery() {
+        base_ = signatureOf(0);
+        int rank = 0;
+        for (int j = 0; j < KEY_BIT; j++) {
+            uint64_t vec = signatureOf(uint32_t(1) << j) ^ base_;
+            uint32_t combo = uint32_t(1) << j;
+            for (int i = 0; i < rank; i++) {
+                if (vec & pivot_[i]) {
+                    vec ^= basis_[i];
+                    combo ^= combo_[i];
+                }
+            }
+            if (vec == 0)
+                continue;
+            basis_[rank] = vec;
+            combo_[rank] = combo;
+            pivot_[rank] = uint64_t(1) << (63 - __builtin_clzll(vec));
+            rank++;
+        }
+        if (rank != KEY_BIT) {
+            fprintf(stderr, "[KeyRecovery] Signatures have rank %d (< %d), cannot recover keys\n", rank, KEY_BIT);
+            exit(1);
+        }
+    }
+    ~KeyRecovery() {}
+
+    /* return false if no 4-byte key has the signature, netKey : Big-Endian (Network) */
+    bool recover(const uint32_t& dysoIdx, const uint32_t& hashkey, uint32_t& netKey) const {
+        uint64_t residue = ((uint64_t(hashkey) << 14) | dysoIdx) ^ base_;
+        uint32_t key = 0;
+        for (int i = 0; i < KEY_BIT; i++) {
+            if (residue & pivot_[i]) {
+                residue ^= basis_[i];
+                key ^= combo_[i];
+            }
+        }
+        netKey = htonl(key);
+        return residue == 0;
+    }
+};
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "StatWorkerThread_multicore.h"
+#include "utils_macro_multicore.h"
+
+/**
+ * Load-aware migration of rows between DySO workers, run periodically by the main thread of pcpp_dyso.o.
+ *
+ * The load of a row is the number of its signatures in the last period (summed over stat cores).
+ * If the busiest worker has more than REBALANCE_THRESHOLD times the mean load, up to REBALANCE_MAX_ROW of its
+ * hottest rows are moved to the least loaded worker, as long as the moved load does not exceed half of their gap.
+ * Replica rows are never moved (self-tuning of their worker), and a moved row stays for REBALANCE_COOLDOWN periods.
+ *
+ * A move is requested to every stat core, which switches the row and marks it in the DySO workers' queues
+ * (see StatWorkerThread::run and DysoWorker::processCtrlMsg). Moves are requested only if the previous ones are applied.
+ */
+class Rebalancer {
+   private:
+    std::vector<StatWorkerThread*> statWorkers_;
+    std::vector<uint32_t> rowWorker_;   // row -> worker as requested so far
+    std::vector<uint32_t> lastLoad_;    // row -> sum of counters of stat cores at the last period
+    std::vector<uint64_t> cooldown_;    // row -> period until which it stays
+    std::vector<uint32_t> rowDelta_;    // row -> signatures in this period
+    uint64_t period_ = 0;
+    uint64_t nMoved_ = 0;
+
+   public:
+    Rebalancer(const std::vector<StatWorkerThread*>& statWorkers)
+        : statWorkers_(statWorkers), rowWorker_(REG_LEN_KEY), lastLoad_(REG_LEN_KEY, 0), cooldown_(REG_LEN_KEY, 0), rowDelta_(REG_LEN_KEY, 0) {
+        for (uint32_t row = 0; row < REG_LEN_KEY; row++)
+            rowWorker_[row] = getReplicaThreadIdx(row);
+    }
+    ~Rebalancer() {}
+
+    /* one period : measure the loads, and move rows if unbalanced. Return the number of rows moved */
+    uint32_t rebalance() {
+        period_++;
+        const uint32_t nWorker = getNumDysoWorker();
+        std::vector<uint64_t> workerLoad(nWorker, 0);
+        uint64_t totalLoad = 0;
+        for (uint32_t row = 0; row < REG_LEN_KEY; row++) {
+            uint32_t load = 0;
+            for (const auto& statWorker : statWorkers_)
+                load += statWorker->getRowLoad(row);
+            rowDelta_[row] = load - lastLoad_[row];  // counters wrap around
+            lastLoad_[row] = load;
+            workerLoad[rowWorker_[row]] += rowDelta_[row];
+            totalLoad += rowDelta_[row];
+        }
+        if (nWorker < 2 || totalLoad < REBALANCE_MIN_LOAD)
+            return 0;
+        for (const auto& statWorker : statWorkers_) {
+            if (statWorker->isMigrationPending())
+                return 0;  // stat core is not running, or busy
+        }
+
+        uint32_t from = uint32_t(std::max_element(workerLoad.begin(), workerLoad.end()) - workerLoad.begin());
+        uint32_t to = uint32_t(std::min_element(workerLoad.begin(), workerLoad.end()) - workerLoad.begin());
+        if (double(workerLoad[from]) <= REBALANCE_THRESHOLD * double(totalLoad) / nWorker)
+            return 0;
+
+        // hottest rows of the busiest worker first
+        std::vector<uint32_t> candidates;
+        for (uint32_t row = 0; row < REG_LEN_KEY; row++) {
+            if (rowWorker_[row] == from && rowDelta_[row] > 0 && cooldown_[row] <= period_ && !checkReplica(row, getReplicaThreadIdx(row)))
+                candidates.push_back(row);
+        }
+        std::sort(candidates.begin(), candidates.end(), [&](const uint32_t& a, const uint32_t& b) { return rowDelta_[a] > rowDelta_[b]; });
+
+        uint64_t budget = (workerLoad[from] - workerLoad[to]) / 2;
+        uint32_t nMoved = 0;
+        for (const auto& row : candidates) {
+            if (nMoved == REBALANCE_MAX_ROW)
+                break;
+            if (rowDelta_[row] > budget)
+                continue;
+            /* all stat cores must take the request, or they would disagree on the worker of the row */
+            bool hasRoom = true;
+            for (const auto& statWorker : statWorkers_)
+                hasRoom = hasRoom && statWorker->hasMigrationRoom();
+            if (!hasRoom)
+                break;  // retry at a next period
+            for (const auto& statWorker : statWorkers_)
+                statWorker->requestMigration(row, to);  // cannot fail (only this thread pushes)
+            budget -= rowDelta_[row];
+            rowWorker_[row] = to;
+            cooldown_[row] = period_ + REBALANCE_COOLDOWN;
+            nMoved++;
+        }
+        nMoved_ += nMoved;
+#if (DYSODEBUG >= 1)
+        if (nMoved > 0)
+            printf("[Rebalancer] Moved %u rows from worker %u (load %lu) to worker %u (load %lu), mean %lu\n",
+                   nMoved, from, workerLoad[from], to, workerLoad[to], totalLoad / nWorker);
+#endif
+        return nMoved;
+    }
+
+    /* Accessor */
+    uint32_t getWorkerOfRow(const uint32_t& row) const { return rowWorker_[row]; }
+    uint64_t getNumMoved() const { return nMoved_; }
+};
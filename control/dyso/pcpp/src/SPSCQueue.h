@@ -23,6 +23,7 @@ SOFTWARE.
 */
 
 #pragma once
+#include <algorithm>
 #include <atomic>
 
 template <class T, uint32_t CNT>
@@ -56,6 +57,16 @@ class SPSCQueue {
         ((std::atomic<uint32_t>*)&write_idx)->store(write_idx + 1, std::memory_order_release);
     }
 
+    /* position of the next push, to check later if that item is consumed (see isPopped) */
+    uint32_t getWriteIdx() const { return write_idx; }
+
+    /* true if the consumer has popped the item pushed at pos */
+    bool isPopped(const uint32_t& pos) {
+        if (int32_t(pos - read_idx_cach) >= 0)
+            read_idx_cach = ((std::atomic<uint32_t>*)&read_idx)->load(std::memory_order_consume);
+        return int32_t(pos - read_idx_cach) < 0;
+    }
+
     template <typename Writer>
     bool tryPush(Writer writer) {
         T* p = alloc();
@@ -71,6 +82,35 @@ class SPSCQueue {
             ;
     }
 
+    /**
+     * For producer (bulk) : the write index is published once per batch
+     * allocN() gives a contiguous span of up to n free slots (shorter at the wrap-around), fill and pushN(cnt).
+     */
+    T* allocN(uint32_t n, uint32_t& cnt) { return allocN(0, n, cnt); }
+
+    void pushN(uint32_t cnt) {
+        ((std::atomic<uint32_t>*)&write_idx)->store(write_idx + cnt, std::memory_order_release);
+    }
+
+    /* copy up to n items (in order), return the number of pushed items */
+    uint32_t tryPushN(const T* items, uint32_t n) {
+        uint32_t pushed = 0, cnt;
+        T* p;
+        while (pushed < n && (p = allocN(pushed, n - pushed, cnt)) != nullptr) {  // two spans at the wrap-around
+            std::copy(items + pushed, items + pushed + cnt, p);
+            pushed += cnt;
+        }
+        if (pushed > 0)
+            pushN(pushed);
+        return pushed;
+    }
+
+    /* number of items, from either side (or a monitor), approximate while both are running */
+    uint32_t size() const {
+        uint32_t r = ((const std::atomic<uint32_t>*)&read_idx)->load(std::memory_order_acquire);  // before write_idx
+        return ((const std::atomic<uint32_t>*)&write_idx)->load(std::memory_order_acquire) - r;
+    }
+
     /**
      * For Consumer
      */
@@ -94,11 +134,59 @@ class SPSCQueue {
         return true;
     }
 
+    /**
+     * For Consumer (bulk) : the read index is published once per batch
+     * frontN() gives a contiguous span of up to n ready slots (shorter at the wrap-around), process in place and popN(cnt).
+     */
+    T* frontN(uint32_t n, uint32_t& cnt) { return frontN(0, n, cnt); }
+
+    void popN(uint32_t cnt) {
+        ((std::atomic<uint32_t>*)&read_idx)->store(read_idx + cnt, std::memory_order_release);
+    }
+
+    /* copy up to n items (in order), return the number of popped items */
+    uint32_t tryPopN(T* items, uint32_t n) {
+        uint32_t popped = 0, cnt;
+        T* p;
+        while (popped < n && (p = frontN(popped, n - popped, cnt)) != nullptr) {  // two spans at the wrap-around
+            std::copy(p, p + cnt, items + popped);
+            popped += cnt;
+        }
+        if (popped > 0)
+            popN(popped);
+        return popped;
+    }
+
    private:
+    /* span of up to n free slots after the (unpublished) offset from write_idx */
+    T* allocN(uint32_t offset, uint32_t n, uint32_t& cnt) {
+        uint32_t idx = write_idx + offset;
+        uint32_t free_cnt = CNT - (idx - read_idx_cach);
+        if (free_cnt < n) {
+            read_idx_cach = ((std::atomic<uint32_t>*)&read_idx)->load(std::memory_order_consume);
+            free_cnt = CNT - (idx - read_idx_cach);
+        }
+        cnt = std::min(std::min(n, free_cnt), CNT - (idx % CNT));
+        return (cnt > 0) ? &data[idx % CNT] : nullptr;
+    }
+
+    /* span of up to n ready slots after the (unpublished) offset from read_idx */
+    T* frontN(uint32_t offset, uint32_t n, uint32_t& cnt) {
+        uint32_t idx = read_idx + offset;
+        uint32_t ready_cnt = write_idx_cach - idx;
+        if (ready_cnt < n || ready_cnt > CNT) {  // > CNT : stale cache behind read_idx (e.g., after front/pop)
+            write_idx_cach = ((std::atomic<uint32_t>*)&write_idx)->load(std::memory_order_acquire);
+            ready_cnt = write_idx_cach - idx;
+        }
+        cnt = std::min(std::min(n, ready_cnt), CNT - (idx % CNT));
+        return (cnt > 0) ? &data[idx % CNT] : nullptr;
+    }
+
     alignas(128) T data[CNT] = {};
 
     alignas(128) uint32_t write_idx = 0;
     uint32_t read_idx_cach = 0;  // used only by writing thread
 
     alignas(128) uint32_t read_idx = 0;
+    uint32_t write_idx_cach = 0;  // used only by reading thread (bulk)
 };
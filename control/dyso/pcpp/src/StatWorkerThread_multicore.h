@@ -1,71 +1,128 @@
 #pragma once
 
 #include <arpa/inet.h>
+#include <string.h>
+
+#include <atomic>
 
 // Custom headers
 #include "utils_header.h"
 #include "utils_macro_multicore.h"
 #include "utils_pcpp.h"
+#include "Telemetry_multicore.h"
 
 // DPDK headers
 #include "DpdkDevice.h"
 #include "DpdkDeviceList.h"
-#include "EthLayer.h"
-#include "IPv4Layer.h"
-#include "Packet.h"
+#include "MBufRawPacket.h"
 
 // initialize a mbuf packet array of size 64 of DPDK
 #define MAX_RECEIVE_BURST 64
-
+// mbufs ahead to prefetch the packet data in a burst
+#define RX_PREFETCH_OFFSET 4
+// migration requests pending per stat core (a period of the Rebalancer must fit)
+constexpr uint32_t MIGRATION_QUEUE_LEN = 64;
+static_assert(REBALANCE_MAX_ROW <= MIGRATION_QUEUE_LEN, "moves of a period must fit in the migration queue");
+
+/**
+ * Stat core : parses control packets into msgs to the SPSCRxQueues of DySO workers.
+ *
+ * Control packets have a custom ether type, so the NIC cannot spread them by RSS : stat core 0 (the only one with
+ * an RX queue) receives all of them and steers each control header by its index_probe to the stat core of its rows
+ * (getStatCoreOfRow), through the fanout queue of that core. An ACK of a row of another stat core is split off to it.
+ * So all msgs of a row (signatures and ACKs) go through one stat core and one SPSCRxQueue, in the order of the NIC.
+ */
 class StatWorkerThread : public pcpp::DpdkWorkerThread {
    private:
     StatWorkerConfig& m_WorkerConfig;
     bool m_Stop;
     uint32_t m_CoreId;
 
+    /* control headers steered to this stat core by stat core 0, and the stat cores to steer to (for stat core 0) */
+    qFanoutSPSC fanoutQueue_;
+    std::vector<StatWorkerThread*> peers_;
+    std::vector<std::queue<pcpp::dysoCtrlhdr>> fanoutBacklog_;  // headers with an ACK waiting for a full fanout queue
+
+    /**
+     * row -> DySO worker of this stat core (dysoRowMap at start), switched by migration requests of the Rebalancer.
+     * A switch defers MIGRATE_OUT to the old worker's queue and MIGRATE_IN to the new one's, in order with the msgs.
+     */
+    std::vector<uint8_t> rowWorker_;
+    SPSCQueue<uint64_t, MIGRATION_QUEUE_LEN> migrationQueue_;  // (dysoIdx << 32) | new worker, from the Rebalancer
+    std::atomic<uint64_t> nMigrationApplied_{0};
+    uint64_t nMigrationRequested_ = 0;                        // written only by the Rebalancer
+
+    /* signatures per row (written only by this stat core, read by the Rebalancer) */
+    std::vector<std::atomic<uint32_t>> rowLoad_;
+
    public:
     StatWorkerThread(StatWorkerConfig& workerConfig)
         : m_WorkerConfig(workerConfig),
           m_Stop(true),
-          m_CoreId(MAX_NUM_OF_CORES + 1) {}
+          m_CoreId(MAX_NUM_OF_CORES + 1),
+          rowWorker_(REG_LEN_KEY),
+          rowLoad_(REG_LEN_KEY) {
+        for (uint32_t row = 0; row < REG_LEN_KEY; row++)
+            rowWorker_[row] = uint8_t(getReplicaThreadIdx(row));
+    }
     ~StatWorkerThread() {}
 
+    /* all stat cores by index, set before running (needed if nCoreForStat > 1) */
+    void setPeers(const std::vector<StatWorkerThread*>& peers) {
+        peers_ = peers;
+        fanoutBacklog_.resize(peers.size());
+    }
+
     bool run(uint32_t cordId) {
         m_CoreId = cordId;
         m_Stop = false;
 
-        /* SPSC shared-memory queue for each DYSO_WORKER */
-        qRxSPSC* m_statQueue[NUM_DYSO_WORKER];
-        for (uint32_t i = 0; i < NUM_DYSO_WORKER; i++) {
-            m_statQueue[i] = getRxQueue(std::to_string(i));  // get SPSC queues
-            if (m_statQueue[i] == nullptr) {
-                std::cerr << "Failed to open qRxSPSC of idx -" << i << std::endl;
+        /* SPSC shared-memory queue for each DYSO_WORKER (of this stat core) */
+        const uint32_t statIdx = m_WorkerConfig.StatIdx;
+        const uint32_t nDysoWorker = getNumDysoWorker();
+        std::vector<qRxSPSC*> m_statQueue(nDysoWorker);
+        std::vector<Doorbell*> m_doorbell(nDysoWorker);  // to wake a parked DySO worker after pushing
+        for (uint32_t i = 0; i < nDysoWorker; i++) {
+            m_statQueue[i] = getRxQueue(statIdx, i);  // get SPSC queues
+            m_doorbell[i] = getDoorbell(i);
+            if (m_statQueue[i] == nullptr || m_doorbell[i] == nullptr) {
+                std::cerr << "Failed to open qRxSPSC of idx -" << statIdx << "_" << i << std::endl;
                 exit(1);
             }
         }
-        std::queue<uint64_t> rxBulkMsgQueue[NUM_DYSO_WORKER];  // bulkMsgQueue for each SPSC queue
-        std::queue<uint64_t> ackQueue[NUM_DYSO_WORKER];        // ACK queue for lossless monitoring
-        uint32_t nRoundRobin = 0;                              // to dequeue with round-robin
+        std::vector<std::vector<uint64_t>> rxBulkMsgQueue(nDysoWorker);  // bulkMsgQueue for each SPSC queue (pushed at once)
+        std::vector<std::queue<uint64_t>> ackQueue(nDysoWorker);         // ACKs and migration markers deferred in order while a queue is full (lossless)
+        uint64_t* migration = nullptr;
+        IdleBackoff backoff(IDLE_SPIN_POLLS, IDLE_PAUSE_POLLS, IDLE_MAX_PAUSE);  // while the NIC queue is empty
+        TelemetryWriter telemetry(TELEMETRY_STAT, statIdx, DYSO_TELEMETRY_PERIOD_US);
+        TelemetryCounters counters = {};
 
         /* For DPDK */
         pcpp::MBufRawPacket* packetArr[MAX_RECEIVE_BURST] = {};  // DPDK RX packet array
         uint32_t packetsReceived = 0;
         uint16_t ethertype = 0;
+        const uint8_t* rawData = nullptr;
         uint64_t* dummyMsg = nullptr;
 
-        /* we use only one RxQueue DPDK per each core */
-        auto rxQueueId = m_WorkerConfig.rxQueueList.front();
-        assert(m_WorkerConfig.rxQueueList.size() == 1);
+        /* stat core 0 polls the only RxQueue of DPDK, and the others their fanout queues */
+        const bool isRxCore = !m_WorkerConfig.rxQueueList.empty();
+        const int rxQueueId = isRxCore ? m_WorkerConfig.rxQueueList.front() : -1;
+        assert(m_WorkerConfig.rxQueueList.size() <= 1 && isRxCore == (statIdx == 0));
+        if (isRxCore && nCoreForStat > 1 && peers_.size() != nCoreForStat) {
+            std::cerr << "[StatWorkerThread] Stat cores to steer control packets are not set" << std::endl;
+            exit(1);
+        }
+        pcpp::dysoCtrlhdr* fanout = nullptr;
 
         /* before starting simulation, refresh all results from prior experiments */
-        for (uint32_t i = 0; i < NUM_DYSO_WORKER; i++) {
-            printf("[StatWorkerThread] Cleaning %u-th queues...\n", i);
+        for (uint32_t i = 0; i < nDysoWorker; i++) {
+            printf("[StatWorkerThread %u] Cleaning %u-th queues...\n", statIdx, i);
             while ((dummyMsg = m_statQueue[i]->front()) != nullptr)
                 m_statQueue[i]->pop();
             assert(m_statQueue[i]->front() == nullptr);
         }
 
-        printf("[StatWorkerThread] Successfully flushed all previous results.\nNow we can start new evaluation.\n");
+        printf("[StatWorkerThread %u] Successfully flushed all previous results.\nNow we can start new evaluation.\n", statIdx);
 
         /* For debugging */
         uint64_t totalCount = 0;
@@ -80,71 +137,119 @@ class StatWorkerThread : public pcpp::DpdkWorkerThread {
         while (!m_Stop) {
             start_ts_per_batch = std::chrono::steady_clock::now();
 
-            // receive a batch of packets
-            packetsReceived = m_WorkerConfig.recvPacketFrom->receivePackets(packetArr, MAX_RECEIVE_BURST, rxQueueId);
+            /* switch rows requested to move (bulk queues are empty here), with markers deferred after the pending msgs of both workers */
+            while ((migration = migrationQueue_.front()) != nullptr) {
+                uint32_t row = uint32_t(*migration >> 32) & (REG_LEN_KEY - 1);
+                uint32_t to = uint32_t(*migration & MSG_MASK_GET_KEY);
+                uint32_t from = rowWorker_[row];
+                if (from != to && to < nDysoWorker) {
+                    ackQueue[from].push(createCtrlMsg(MSG_CTRL_MIGRATE_OUT, row, to));
+                    ackQueue[to].push(createCtrlMsg(MSG_CTRL_MIGRATE_IN, row, from));
+                    rowWorker_[row] = uint8_t(to);
+                }
+                migrationQueue_.pop();
+                nMigrationApplied_.fetch_add(1, std::memory_order_release);
+            }
 
-            /* iterate for each received pkt */
-            for (uint32_t i = 0; i < packetsReceived; i++) {
-                pcpp::Packet parsedPacket(packetArr[i]);
-                pcpp::EthLayer* ethernetLayer = parsedPacket.getLayerOfType<pcpp::EthLayer>();
-                if (ethernetLayer == NULL) {
-                    std::cerr << "[StatWorkerThread] Couldn't find Ethernet layer" << std::endl;
-                    return 1;
+            if (isRxCore) {
+                /* headers waiting for full fanout queues go first (in order) */
+                for (uint32_t i = 0; i < fanoutBacklog_.size(); i++) {
+                    while (!fanoutBacklog_[i].empty() && peers_[i]->fanoutQueue_.tryPush([&](pcpp::dysoCtrlhdr* hdr) { *hdr = fanoutBacklog_[i].front(); }))
+                        fanoutBacklog_[i].pop();
                 }
 
-                ethertype = pcpp::netToHost16(ethernetLayer->getEthHeader()->etherType);
+                // receive a batch of packets
+                packetsReceived = m_WorkerConfig.recvPacketFrom->receivePackets(packetArr, MAX_RECEIVE_BURST, rxQueueId);
 
-                /* Ether type (control: 0xDEAD=57005) */
-                if (ethertype == 57005) {
-                    pcpp::Layer* dysoUpdateLayer = ethernetLayer->getNextLayer();
-                    if (dysoUpdateLayer == NULL) {
-                        std::cerr << "[StatWorkerThread] Couldn't find DysoUpdate layer" << std::endl;
-                        return 1;
-                    }
-                    pcpp::dysoCtrlhdr* data = (pcpp::dysoCtrlhdr*)dysoUpdateLayer->getData();
-                    enQueueCtrlPkt(data, rxBulkMsgQueue);
+                /* prefetch the data of first mbufs */
+                for (uint32_t i = 0; i < packetsReceived && i < RX_PREFETCH_OFFSET; i++)
+                    __builtin_prefetch(packetArr[i]->getRawData());
+
+                /* iterate for each received pkt (control header at a fixed offset, no layer parsing) */
+                for (uint32_t i = 0; i < packetsReceived; i++) {
+                    if (i + RX_PREFETCH_OFFSET < packetsReceived)
+                        __builtin_prefetch(packetArr[i + RX_PREFETCH_OFFSET]->getRawData());
+
+                    if (packetArr[i]->getRawDataLen() < int(ETH_HDR_LEN + sizeof(pcpp::dysoCtrlhdr)))
+                        continue;  // runt or non-control packet
+                    rawData = packetArr[i]->getRawData();
+                    memcpy(&ethertype, rawData + ETH_HDR_LEN - sizeof(ethertype), sizeof(ethertype));
+
+                    /* Ether type (control: 0xDEAD=57005) */
+                    if (ntohs(ethertype) == ETHERTYPE_CTRL)
+                        steerCtrlPkt((pcpp::dysoCtrlhdr*)(rawData + ETH_HDR_LEN), rxBulkMsgQueue.data(), counters);
+                }
+            } else {
+                /* headers steered by stat core 0 */
+                for (packetsReceived = 0; packetsReceived < MAX_RECEIVE_BURST && (fanout = fanoutQueue_.front()) != nullptr; packetsReceived++) {
+                    enQueueCtrlPkt(fanout, rxBulkMsgQueue.data());
+                    fanoutQueue_.pop();
                 }
             }
 
-            /* Flush previously failed ACK msgs */
-            nRoundRobin = (nRoundRobin + 1) % NUM_DYSO_WORKER;
-            while (!ackQueue[nRoundRobin].empty()) {
-                if ((dummyMsg = m_statQueue[nRoundRobin]->alloc()) != nullptr) {
-                    *dummyMsg = ackQueue[nRoundRobin].front();
-                    m_statQueue[nRoundRobin]->push();
-                    ackQueue[nRoundRobin].pop();
-                } else {
-                    break;
+            /* Flush deferred ACKs and migration markers (before any new msg of the queue, to keep the order of a row) */
+            for (uint32_t i = 0; i < nDysoWorker; i++) {
+                if (ackQueue[i].empty())
+                    continue;
+                while (!ackQueue[i].empty() && (dummyMsg = m_statQueue[i]->alloc()) != nullptr) {
+                    *dummyMsg = ackQueue[i].front();
+                    m_statQueue[i]->push();
+                    ackQueue[i].pop();
                 }
+                m_doorbell[i]->ring();
             }
 
-            /* Flush to shared memory queues */
-            for (uint32_t i = 0; i < NUM_DYSO_WORKER; i++) {
-                for (; !rxBulkMsgQueue[i].empty(); rxBulkMsgQueue[i].pop()) {
-                    uint64_t& msg = rxBulkMsgQueue[i].front();
-                    if ((dummyMsg = m_statQueue[i]->alloc()) != nullptr) {
-                        *dummyMsg = msg;
-                        m_statQueue[i]->push();
-                        totalCount += 1;
-                    } else {
-                        // std::cerr << "[StatWorkerThread] queue overflow at dyso_worker" << i << std::endl;
-                        // exit(0);
-
-                        /* Keep the ACK packets and retry later */
-                        if ((msg & MSG_MASK_UPDATE_FLAG) == MSG_MASK_UPDATE_FLAG) {
-                            ackQueue[i].push(msg);
+            /* Flush to shared memory queues (write index is published once per queue), unless ACKs are still deferred */
+            for (uint32_t i = 0; i < nDysoWorker; i++) {
+                uint32_t nPushed = ackQueue[i].empty() ? m_statQueue[i]->tryPushN(rxBulkMsgQueue[i].data(), rxBulkMsgQueue[i].size()) : 0;
+                totalCount += nPushed;
+                counters.nMsgs += nPushed;
+                if (nPushed > 0)
+                    m_doorbell[i]->ring();
+                for (uint32_t j = nPushed; j < rxBulkMsgQueue[i].size(); j++) {
+                    // std::cerr << "[StatWorkerThread] queue overflow at dyso_worker" << i << std::endl;
+                    // exit(0);
+
+                    /* Keep the ACK packets and retry later */
+                    uint64_t& msg = rxBulkMsgQueue[i][j];
+                    if ((msg & MSG_MASK_UPDATE_FLAG) == MSG_MASK_UPDATE_FLAG) {
+                        ackQueue[i].push(msg);
 #if (DYSODEBUG == 2)
-                            printf("[StatWorkerThread] failed ack digest, core: %u, idx: %lu, totalCount: %lu\n",
-                                   i, (msg - MSG_MASK_UPDATE_FLAG) >> 32, totalCount);
+                        printf("[StatWorkerThread] failed ack digest, core: %u, idx: %lu, totalCount: %lu\n",
+                               i, ((msg - MSG_MASK_UPDATE_FLAG) >> 32) & (REG_LEN_KEY - 1), totalCount);
 #endif
-                        }
+                    }
 #if (DYSODEBUG == 2)
-                        else {
-                            printf("[StatWorkerThread] failed msg digest\n");
-                        }
-#endif
+                    else {
+                        printf("[StatWorkerThread] failed msg digest\n");
                     }
+#endif
+                    counters.nDropped += ((msg & MSG_MASK_UPDATE_FLAG) == MSG_MASK_UPDATE_FLAG) ? 0 : 1;
                 }
+                rxBulkMsgQueue[i].clear();
+            }
+
+#if (DYSO_IDLE_PARK == 1)
+            /* back off while the NIC queue is empty (no wakeup from the NIC, so parking is a short sleep) */
+            if (packetsReceived > 0)
+                backoff.reset();
+            else if (backoff.idle())
+                usleep(IDLE_NIC_SLEEP_US);
+#endif
+
+            /* publish telemetry (see Telemetry_multicore.h) */
+            counters.nPkts += packetsReceived;
+            if (telemetry.due(start_ts_per_batch)) {
+                counters.ackBacklog = 0;
+                counters.ringOccupancy = 0;
+                for (uint32_t i = 0; i < nDysoWorker; i++) {
+                    counters.ackBacklog += ackQueue[i].size();
+                    counters.ringOccupancy += m_statQueue[i]->size();
+                }
+                for (const auto& backlog : fanoutBacklog_)
+                    counters.ackBacklog += backlog.size();
+                counters.nParked = backoff.getNumPark();
+                telemetry.publish(counters, start_ts_per_batch);
             }
 
             /* LOGGING TIMESTAMP */
@@ -156,7 +261,7 @@ class StatWorkerThread : public pcpp::DpdkWorkerThread {
             }
 
             if (total_number_of_pkts > 1000000) { // 1 Million Pkts
-                printf("[StatWorkerThread] Avg time to process 1 pkt: %lu (ns)\n", total_elapsed_time / total_number_of_pkts);
+                printf("[StatWorkerThread %u] Avg time to process 1 pkt: %lu (ns)\n", statIdx, total_elapsed_time / total_number_of_pkts);
                 total_number_of_pkts = 0;
                 total_elapsed_time = 0;
             }
@@ -168,8 +273,10 @@ class StatWorkerThread : public pcpp::DpdkWorkerThread {
                 end = std::chrono::steady_clock::now();
                 auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
                 printf("[StatWorkerThread] Time to process 1 msg: %lu (ns)\n", uint64_t(elapsed) / totalCount);
-                printf("[StatWorkerThread] ACKBufferSize: %lu, %lu, %lu, %lu\n",
-                       ackQueue[0].size(), ackQueue[1].size(), ackQueue[2].size(), ackQueue[3].size());
+                printf("[StatWorkerThread] ACKBufferSize:");
+                for (uint32_t i = 0; i < nDysoWorker; i++)
+                    printf(" %lu", ackQueue[i].size());
+                printf("\n");
                 totalCount = 0;
                 start = end;
             }
@@ -178,12 +285,49 @@ class StatWorkerThread : public pcpp::DpdkWorkerThread {
         return true;
     }
 
-    void enQueueCtrlPkt(pcpp::dysoCtrlhdr* data, std::queue<uint64_t>* bulkMsgQueue) {
+    /* For stat core 0 : parse a control header here, or pass it to the stat core of its rows (the ACK to the one of its row) */
+    void steerCtrlPkt(pcpp::dysoCtrlhdr* data, std::vector<uint64_t>* bulkMsgQueue, TelemetryCounters& counters) {
+        const uint32_t index_update = ntohl(data->index_update);
+        const uint32_t probeCore = getStatCoreOfRow(ntohl(data->index_probe) << REG_LEN_DYSO_IDX_BIT);
+        const uint32_t ackCore = (index_update != DEFAULT_EMPTY_VALUE) ? getStatCoreOfRow(index_update & (REG_LEN_KEY - 1)) : probeCore;
+        if (probeCore == 0 && ackCore == 0) {
+            enQueueCtrlPkt(data, bulkMsgQueue);
+            return;
+        }
+        pcpp::dysoCtrlhdr sigs = *data;
+        if (ackCore != probeCore) {
+            pcpp::dysoCtrlhdr ack = {};  // no signatures (recs are 0)
+            ack.index_update = data->index_update;
+            sigs.index_update = htonl(DEFAULT_EMPTY_VALUE);
+            if (ackCore == 0)
+                enQueueCtrlPkt(&ack, bulkMsgQueue);
+            else
+                forwardCtrlPkt(ackCore, ack, counters);
+        }
+        if (probeCore == 0)
+            enQueueCtrlPkt(&sigs, bulkMsgQueue);
+        else
+            forwardCtrlPkt(probeCore, sigs, counters);
+    }
+
+    /* headers with an ACK are kept (lossless, in order) while the fanout queue is full, others are dropped */
+    void forwardCtrlPkt(const uint32_t& statIdx, const pcpp::dysoCtrlhdr& data, TelemetryCounters& counters) {
+        std::queue<pcpp::dysoCtrlhdr>& backlog = fanoutBacklog_[statIdx];
+        if (backlog.empty() && peers_[statIdx]->fanoutQueue_.tryPush([&](pcpp::dysoCtrlhdr* hdr) { *hdr = data; }))
+            return;
+        if (ntohl(data.index_update) != DEFAULT_EMPTY_VALUE)
+            backlog.push(data);
+        else
+            counters.nDropped += (data.rec0 != 0) + (data.rec1 != 0) + (data.rec2 != 0) + (data.rec3 != 0) +
+                                 (data.rec4 != 0) + (data.rec5 != 0) + (data.rec6 != 0) + (data.rec7 != 0);
+    }
+
+    void enQueueCtrlPkt(const pcpp::dysoCtrlhdr* data, std::vector<uint64_t>* bulkMsgQueue) {
         // index of update
         uint32_t index_update = (ntohl(data->index_update));  // index of updated dyso
-        if (index_update != 7777777) {                        // ignore empty-update
+        if (index_update != DEFAULT_EMPTY_VALUE) {            // ignore empty-update
             uint64_t msg_update = (uint64_t(index_update) << 32) + MSG_MASK_UPDATE_FLAG;
-            bulkMsgQueue[index_update % NUM_DYSO_WORKER].push(msg_update);
+            bulkMsgQueue[rowWorker_[index_update & (REG_LEN_KEY - 1)]].push_back(msg_update);
         }
 
         // index of probe
@@ -192,60 +336,95 @@ class StatWorkerThread : public pcpp::DpdkWorkerThread {
         // rec0
         uint32_t reg0 = ntohl(data->rec0);
         if (reg0 != 0) {
-            uint64_t msg0 = createMsgToStatThread(index_probe + (reg0 >> REG_LEN_HASHKEY_BIT), REG_MASK_GET_HASHKEY & reg0);
-            bulkMsgQueue[(reg0 >> REG_LEN_HASHKEY_BIT) % NUM_DYSO_WORKER].push(msg0);
+            uint32_t idx0 = index_probe + (reg0 >> REG_LEN_HASHKEY_BIT);
+            uint64_t msg0 = createMsgToStatThread(idx0, REG_MASK_GET_HASHKEY & reg0);
+            bulkMsgQueue[getWorkerOfRow(idx0)].push_back(msg0);
         }
 
         // rec1
         uint32_t reg1 = ntohl(data->rec1);
         if (reg1 != 0) {
-            uint64_t msg1 = createMsgToStatThread(index_probe + (reg1 >> REG_LEN_HASHKEY_BIT), REG_MASK_GET_HASHKEY & reg1);
-            bulkMsgQueue[(reg1 >> REG_LEN_HASHKEY_BIT) % NUM_DYSO_WORKER].push(msg1);
+            uint32_t idx1 = index_probe + (reg1 >> REG_LEN_HASHKEY_BIT);
+            uint64_t msg1 = createMsgToStatThread(idx1, REG_MASK_GET_HASHKEY & reg1);
+            bulkMsgQueue[getWorkerOfRow(idx1)].push_back(msg1);
         }
 
         // rec2
         uint32_t reg2 = ntohl(data->rec2);
         if (reg2 != 0) {
-            uint64_t msg2 = createMsgToStatThread(index_probe + (reg2 >> REG_LEN_HASHKEY_BIT), REG_MASK_GET_HASHKEY & reg2);
-            bulkMsgQueue[(reg2 >> REG_LEN_HASHKEY_BIT) % NUM_DYSO_WORKER].push(msg2);
+            uint32_t idx2 = index_probe + (reg2 >> REG_LEN_HASHKEY_BIT);
+            uint64_t msg2 = createMsgToStatThread(idx2, REG_MASK_GET_HASHKEY & reg2);
+            bulkMsgQueue[getWorkerOfRow(idx2)].push_back(msg2);
         }
 
         // rec3
         uint32_t reg3 = ntohl(data->rec3);
         if (reg3 != 0) {
-            uint64_t msg3 = createMsgToStatThread(index_probe + (reg3 >> REG_LEN_HASHKEY_BIT), REG_MASK_GET_HASHKEY & reg3);
-            bulkMsgQueue[(reg3 >> REG_LEN_HASHKEY_BIT) % NUM_DYSO_WORKER].push(msg3);
+            uint32_t idx3 = index_probe + (reg3 >> REG_LEN_HASHKEY_BIT);
+            uint64_t msg3 = createMsgToStatThread(idx3, REG_MASK_GET_HASHKEY & reg3);
+            bulkMsgQueue[getWorkerOfRow(idx3)].push_back(msg3);
         }
 
         // rec4
         uint32_t reg4 = ntohl(data->rec4);
         if (reg4 != 0) {
-            uint64_t msg4 = createMsgToStatThread(index_probe + (reg4 >> REG_LEN_HASHKEY_BIT), REG_MASK_GET_HASHKEY & reg4);
-            bulkMsgQueue[(reg4 >> REG_LEN_HASHKEY_BIT) % NUM_DYSO_WORKER].push(msg4);
+            uint32_t idx4 = index_probe + (reg4 >> REG_LEN_HASHKEY_BIT);
+            uint64_t msg4 = createMsgToStatThread(idx4, REG_MASK_GET_HASHKEY & reg4);
+            bulkMsgQueue[getWorkerOfRow(idx4)].push_back(msg4);
         }
 
         // rec5
         uint32_t reg5 = ntohl(data->rec5);
         if (reg5 != 0) {
-            uint64_t msg5 = createMsgToStatThread(index_probe + (reg5 >> REG_LEN_HASHKEY_BIT), REG_MASK_GET_HASHKEY & reg5);
-            bulkMsgQueue[(reg5 >> REG_LEN_HASHKEY_BIT) % NUM_DYSO_WORKER].push(msg5);
+            uint32_t idx5 = index_probe + (reg5 >> REG_LEN_HASHKEY_BIT);
+            uint64_t msg5 = createMsgToStatThread(idx5, REG_MASK_GET_HASHKEY & reg5);
+            bulkMsgQueue[getWorkerOfRow(idx5)].push_back(msg5);
         }
 
         // rec6
         uint32_t reg6 = ntohl(data->rec6);
         if (reg6 != 0) {
-            uint64_t msg6 = createMsgToStatThread(index_probe + (reg6 >> REG_LEN_HASHKEY_BIT), REG_MASK_GET_HASHKEY & reg6);
-            bulkMsgQueue[(reg6 >> REG_LEN_HASHKEY_BIT) % NUM_DYSO_WORKER].push(msg6);
+            uint32_t idx6 = index_probe + (reg6 >> REG_LEN_HASHKEY_BIT);
+            uint64_t msg6 = createMsgToStatThread(idx6, REG_MASK_GET_HASHKEY & reg6);
+            bulkMsgQueue[getWorkerOfRow(idx6)].push_back(msg6);
         }
 
         // rec7
         uint32_t reg7 = ntohl(data->rec7);
         if (reg7 != 0) {
-            uint64_t msg7 = createMsgToStatThread(index_probe + (reg7 >> REG_LEN_HASHKEY_BIT), REG_MASK_GET_HASHKEY & reg7);
-            bulkMsgQueue[(reg7 >> REG_LEN_HASHKEY_BIT) % NUM_DYSO_WORKER].push(msg7);
+            uint32_t idx7 = index_probe + (reg7 >> REG_LEN_HASHKEY_BIT);
+            uint64_t msg7 = createMsgToStatThread(idx7, REG_MASK_GET_HASHKEY & reg7);
+            bulkMsgQueue[getWorkerOfRow(idx7)].push_back(msg7);
         }
     }
 
+    /* worker of a signature's row, counted in its load */
+    uint32_t getWorkerOfRow(const uint32_t& idx) {
+        uint32_t row = idx & (REG_LEN_KEY - 1);
+        rowLoad_[row].store(rowLoad_[row].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);  // single writer
+        return rowWorker_[row];
+    }
+
+    /**
+     * For the Rebalancer (another thread)
+     * A request is applied at the next loop of this stat core. Return false if too many requests are pending.
+     */
+    bool hasMigrationRoom() const {
+        return migrationQueue_.size() < MIGRATION_QUEUE_LEN;  // only shrinks until the next request
+    }
+    bool requestMigration(const uint32_t& row, const uint32_t& to) {
+        if (!migrationQueue_.tryPush([&](uint64_t* request) { *request = (uint64_t(row) << 32) | to; }))
+            return false;
+        nMigrationRequested_++;
+        return true;
+    }
+    bool isMigrationPending() const {
+        return nMigrationApplied_.load(std::memory_order_acquire) != nMigrationRequested_;
+    }
+    uint32_t getRowLoad(const uint32_t& row) const {
+        return rowLoad_[row].load(std::memory_order_relaxed);  // wraps around, use differences
+    }
+
     void stop() {
         m_Stop = true;
     }
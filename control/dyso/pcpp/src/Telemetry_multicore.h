@@ -0,0 +1,128 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "shmmap.h"
+
+/**
+ * Telemetry page of a worker (stat core, update core, or DySO worker) in shared memory,
+ * at TELEMETRY_SHM_PREFIX + "<role>_<index>" (always shared memory, also in the single-process mode).
+ *
+ * The worker publishes its counters every DYSO_TELEMETRY_PERIOD_US under a seqlock : readers (dyso_telemetry.o)
+ * only load the page and retry if it changed meanwhile, so they never write to the cache lines of the worker.
+ * Counters are cumulative (rates are given by differences between samples) unless noted.
+ */
+#define TELEMETRY_SHM_PREFIX "/shm_dyso_telemetry_"
+constexpr uint64_t TELEMETRY_MAGIC = 0x44594D4554525943;  // "DYMETRYC"
+
+enum TelemetryRole : uint32_t {
+    TELEMETRY_STAT = 0,
+    TELEMETRY_UPDATE = 1,
+    TELEMETRY_DYSO = 2,
+};
+
+inline const char* getTelemetryRoleName(const uint32_t& role) {
+    return (role == TELEMETRY_STAT) ? "stat" : (role == TELEMETRY_UPDATE) ? "update" : "dyso";
+}
+inline std::string getTelemetryName(const uint32_t& role, const uint32_t& idx) {
+    return std::string(TELEMETRY_SHM_PREFIX) + getTelemetryRoleName(role) + "_" + std::to_string(idx);
+}
+
+struct TelemetryCounters {
+    uint64_t timestampNs;      // steady clock at publish (same clock in all processes)
+    uint64_t nPkts;            // packets from the NIC (stat, update)
+    uint64_t nMsgs;            // msgs pushed to DySO workers (stat), UPDATEs sent (update), msgs digested (dyso)
+    uint64_t nDropped;         // signatures at full queues (stat), TX drops (update), stray msgs (dyso)
+    uint64_t ackBacklog;       // ACKs waiting for full queues (stat), now
+    uint64_t ringOccupancy;    // msgs in the SPSC queues it pushes to (stat) or pops from (update, dyso), now
+    uint64_t nUpdateInFlight;  // UPDATEs without ACK yet (dyso), now
+    uint64_t nParked;          // parks of the idle loop
+    uint32_t agingPeriod;      // (dyso), now
+    uint32_t nRows;            // rows owned (dyso), now
+    double hitRatioUp;         // virtual hit ratio of up/down replicas (dyso), now
+    double hitRatioDown;
+};
+
+class TelemetryPage {
+   private:
+    uint64_t magic_;
+    uint32_t role_;
+    uint32_t idx_;
+    alignas(64) std::atomic<uint32_t> seq_;  // odd while the worker is writing
+    TelemetryCounters counters_;
+
+   public:
+    /**
+     * For the worker (single writer). A page is zero-filled at creation, but a page left by a previous run
+     * (possibly killed while writing, with an odd seq) is reused : invalidate it, make seq even, and clear the counters
+     * under the seqlock, so readers attached meanwhile never see a stuck or torn page.
+     */
+    void init(const uint32_t& role, const uint32_t& idx) {
+        magic_ = 0;
+        std::atomic_thread_fence(std::memory_order_release);  // invalid before the rest
+        role_ = role;
+        idx_ = idx;
+        seq_.store(seq_.load(std::memory_order_relaxed) & ~1u, std::memory_order_relaxed);
+        publish({});
+        std::atomic_thread_fence(std::memory_order_release);  // valid after the rest
+        magic_ = TELEMETRY_MAGIC;
+    }
+    void publish(const TelemetryCounters& counters) {
+        uint32_t seq = seq_.load(std::memory_order_relaxed);
+        seq_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);  // odd seq before the counters
+        counters_ = counters;
+        seq_.store(seq + 2, std::memory_order_release);
+    }
+
+    /* For readers : return false if the page is being written (retry) */
+    bool read(TelemetryCounters& counters) const {
+        uint32_t seq = seq_.load(std::memory_order_acquire);
+        if (seq & 1)
+            return false;
+        counters = counters_;
+        std::atomic_thread_fence(std::memory_order_acquire);  // counters before the second seq
+        return seq_.load(std::memory_order_relaxed) == seq;
+    }
+    bool isValid() const { return magic_ == TELEMETRY_MAGIC; }
+    uint32_t getRole() const { return role_; }
+    uint32_t getIdx() const { return idx_; }
+};
+
+/* page of a worker, published at most every periodUs (no page if it cannot be created) */
+class TelemetryWriter {
+   private:
+    TelemetryPage* page_ = nullptr;
+    const uint64_t periodNs_;
+    uint64_t nextNs_ = 0;
+
+   public:
+    TelemetryWriter(const uint32_t& role, const uint32_t& idx, const uint32_t& periodUs) : periodNs_(uint64_t(periodUs) * 1000) {
+        if (periodUs == 0)
+            return;
+        if ((page_ = spsc_shmmap<TelemetryPage>(getTelemetryName(role, idx).c_str())) == nullptr) {
+            std::cerr << "Failed to open telemetry page of " << getTelemetryRoleName(role) << " " << idx << ", disabled" << std::endl;
+            return;
+        }
+        page_->init(role, idx);
+    }
+    ~TelemetryWriter() {}
+
+    /* true if the counters are to be published now (then fill them, and publish) */
+    bool due(const std::chrono::steady_clock::time_point& now) {
+        uint64_t nowNs = std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
+        if (page_ == nullptr || nowNs < nextNs_)
+            return false;
+        nextNs_ = nowNs + periodNs_;
+        return true;
+    }
+    void publish(TelemetryCounters& counters, const std::chrono::steady_clock::time_point& now) {
+        counters.timestampNs = std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
+        page_->publish(counters);
+    }
+};
@@ -1,28 +1,52 @@
 #pragma once
 
 #include <arpa/inet.h>
+#include <string.h>
+
+#include <atomic>
 
 // Custom headers
 #include "utils_header.h"
 #include "utils_macro_multicore.h"
 #include "utils_pcpp.h"
+#include "Telemetry_multicore.h"
 
 // DPDK headers
 #include "DpdkDevice.h"
 #include "DpdkDeviceList.h"
-#include "EthLayer.h"
-#include "IPv4Layer.h"
-#include "Packet.h"
+#include "MBufRawPacket.h"
 
 // initialize a mbuf packet array of size 64
 #define MAX_RECEIVE_BURST 64
-
+// mbufs ahead to prefetch the packet data in a burst
+#define TX_PREFETCH_OFFSET 4
+
+/**
+ * Update core : rewrites control packets from the data plane into UPDATEs dequeued from the SPSCTxQueues of DySO workers.
+ *
+ * The NIC does not spread control packets (custom ether type) over the RX queues of update cores by RSS, so an update
+ * core may get all or none of them : every update core dispatches the queues of all DySO workers, and a queue is popped
+ * by one update core at a time (try-lock in process memory, skipped if it is taken). With one update core, no lock.
+ */
 class UpdateWorkerThread : public pcpp::DpdkWorkerThread {
    private:
     UpdateWorkerConfig& m_WorkerConfig;
     bool m_Stop;
     uint32_t m_CoreId;
 
+    /* consumer lock of the SPSCTxQueue of each DySO worker, shared by update cores */
+    static std::atomic<uint32_t>* getTxQueueLock(const uint32_t& workerIdx) {
+        static std::atomic<uint32_t> locks[MAX_DYSO_WORKER];
+        return &locks[workerIdx];
+    }
+    static bool tryLockTxQueue(const uint32_t& workerIdx) {
+        return nCoreForUpdate == 1 || getTxQueueLock(workerIdx)->exchange(1, std::memory_order_acquire) == 0;
+    }
+    static void unlockTxQueue(const uint32_t& workerIdx) {
+        if (nCoreForUpdate > 1)
+            getTxQueueLock(workerIdx)->store(0, std::memory_order_release);
+    }
+
    public:
     UpdateWorkerThread(UpdateWorkerConfig& workerConfig)
         : m_WorkerConfig(workerConfig),
@@ -34,9 +58,12 @@ class UpdateWorkerThread : public pcpp::DpdkWorkerThread {
         m_CoreId = coreId;
         m_Stop = false;
 
-        uint32_t nRoundRobin = 0;  // to dequeue with round-robin
-        qTxSPSC* m_updateQueue[NUM_DYSO_WORKER];
-        for (uint32_t i = 0; i < NUM_DYSO_WORKER; i++) {
+        /* SPSC shared-memory queues of all DySO workers (popped under getTxQueueLock) */
+        const uint32_t updateIdx = m_WorkerConfig.UpdateIdx;
+        const uint32_t nUpdateQueue = getNumDysoWorker();
+        uint32_t nRoundRobin = updateIdx % nUpdateQueue;  // to dequeue with round-robin (update cores start apart)
+        std::vector<qTxSPSC*> m_updateQueue(nUpdateQueue);
+        for (uint32_t i = 0; i < nUpdateQueue; i++) {
             m_updateQueue[i] = getTxQueue(std::to_string(i));  // get SPSC queues
             if (m_updateQueue[i] == nullptr) {
                 std::cerr << "Failed to open qTxSPSC of idx -" << i << std::endl;
@@ -46,12 +73,20 @@ class UpdateWorkerThread : public pcpp::DpdkWorkerThread {
 
         /* For DPDK */
         pcpp::MBufRawPacket* packetArr[MAX_RECEIVE_BURST] = {};
+        pcpp::MBufRawPacket* txPacketArr[MAX_RECEIVE_BURST] = {};  // rewritten packets, sent back at once
         uint32_t packetsReceived = 0;
+        uint32_t packetsToSend = 0;
+        uint32_t packetsSent = 0;
+        uint64_t totalDropped = 0;
         uint16_t ethertype = 0;
+        uint8_t* rawData = nullptr;
 
         /* For debugging */
         bool success_dequeue = false;
         uint64_t totalCount = 0;
+        IdleBackoff backoff(IDLE_SPIN_POLLS, IDLE_PAUSE_POLLS, IDLE_MAX_PAUSE);  // while the NIC queue is empty
+        TelemetryWriter telemetry(TELEMETRY_UPDATE, updateIdx, DYSO_TELEMETRY_PERIOD_US);
+        TelemetryCounters counters = {};
         auto start = std::chrono::steady_clock::now();
         auto end = std::chrono::steady_clock::now();
 
@@ -67,14 +102,16 @@ class UpdateWorkerThread : public pcpp::DpdkWorkerThread {
 
         /* before starting simulation, refresh all results from prior experiments */
         pcpp::dysoCtrlhdr* dummyData;
-        for (uint32_t i = 0; i < NUM_DYSO_WORKER; i++) {
-            printf("[UpdateWorkerThread] Cleaning %u-th queues...\n", i);
+        for (uint32_t i = 0; i < nUpdateQueue && updateIdx == 0; i++) {
+            printf("[UpdateWorkerThread %u] Cleaning %u-th queues...\n", updateIdx, i);
+            while (!tryLockTxQueue(i))
+                cpuRelax();
             while ((dummyData = m_updateQueue[i]->front()) != nullptr)
                 m_updateQueue[i]->pop();
-            assert(m_updateQueue[i]->front() == nullptr);
+            unlockTxQueue(i);
         }
 
-        printf("[UpdateWorkerThread] Successfully flushed all previous results.\n--> Now we can start new evaluation.\n");
+        printf("[UpdateWorkerThread %u] Successfully flushed all previous results.\n--> Now we can start new evaluation.\n", updateIdx);
 
         while (!m_Stop) {
             start_ts_per_batch = std::chrono::steady_clock::now();
@@ -82,43 +119,48 @@ class UpdateWorkerThread : public pcpp::DpdkWorkerThread {
             /* step 1. receive a batch of update packets from data plane */
             packetsReceived = m_WorkerConfig.recvPacketFrom->receivePackets(packetArr, MAX_RECEIVE_BURST, rxQueueId);
 
+            /* prefetch the data of first mbufs */
+            for (uint32_t i = 0; i < packetsReceived && i < TX_PREFETCH_OFFSET; i++)
+                __builtin_prefetch(packetArr[i]->getRawData(), 1);
+
+            packetsToSend = 0;
             for (uint32_t i = 0; i < packetsReceived; i++) {
-                /* step 2. check the packet is UPDATE */
-                pcpp::Packet parsedPacket(packetArr[i]);
-                pcpp::EthLayer* ethernetLayer = parsedPacket.getLayerOfType<pcpp::EthLayer>();
-                if (ethernetLayer == NULL) {
-                    std::cerr << "[UpdateCore] Something went wrong, couldn't find Ethernet layer" << std::endl;
-                    exit(1);
-                }
-                ethertype = pcpp::netToHost16(ethernetLayer->getEthHeader()->etherType);
+                if (i + TX_PREFETCH_OFFSET < packetsReceived)
+                    __builtin_prefetch(packetArr[i + TX_PREFETCH_OFFSET]->getRawData(), 1);
+
+                /* step 2. check the packet is UPDATE (control header at a fixed offset, no layer parsing) */
+                if (packetArr[i]->getRawDataLen() < int(ETH_HDR_LEN + sizeof(pcpp::dysoCtrlhdr)))
+                    continue;  // runt or non-control packet
+                rawData = (uint8_t*)packetArr[i]->getRawData();
+                memcpy(&ethertype, rawData + ETH_HDR_LEN - sizeof(ethertype), sizeof(ethertype));
 #if (DYSODEBUG == 2)
-                printf("[UpdateCore] Received packet with ethertype %u\n", ethertype);
+                printf("[UpdateCore] Received packet with ethertype %u\n", ntohs(ethertype));
 #endif
                 /* Ether type (update: 0xDEAD=57005) */
-                /* Update Header then send back to Data plane */
-                if (ethertype == 57005) {
-                    /* UPDATE */
-                    pcpp::Layer* dysoLayer = ethernetLayer->getNextLayer();
-                    if (dysoLayer == NULL) {
-                        std::cerr << "[UpdateCore] Something went wrong, couldn't find DysoUpdate layer" << std::endl;
-                        exit(1);
-                    }
-                    pcpp::dysoCtrlhdr* data = (pcpp::dysoCtrlhdr*)dysoLayer->getData();
-                    /***********/
+                /* Update Header in place, then send back to Data plane with the burst */
+                if (ntohs(ethertype) == ETHERTYPE_CTRL) {
+                    pcpp::dysoCtrlhdr* data = (pcpp::dysoCtrlhdr*)(rawData + ETH_HDR_LEN);
 
-                    /* dequeue in a round-robin and send packet with data */
+                    /* dequeue in a round-robin and rewrite packet with data */
                     pcpp::dysoCtrlhdr* fetched;
                     success_dequeue = false;
-                    for (uint32_t i = nRoundRobin; i < nRoundRobin + NUM_DYSO_WORKER; i++) {
-                        if ((fetched = m_updateQueue[i % NUM_DYSO_WORKER]->front()) != nullptr) {
+                    for (uint32_t j = nRoundRobin; j < nRoundRobin + nUpdateQueue; j++) {
+                        const uint32_t q = j % nUpdateQueue;
+                        if (m_updateQueue[q]->size() == 0 || !tryLockTxQueue(q))
+                            continue;  // empty, or being popped by another update core
+                        if ((fetched = m_updateQueue[q]->front()) != nullptr) {
                             memcpy(data, fetched, sizeof(pcpp::dysoCtrlhdr));
-                            m_updateQueue[i % NUM_DYSO_WORKER]->pop();
+                            m_updateQueue[q]->pop();
+                        }
+                        unlockTxQueue(q);
+                        if (fetched != nullptr) {
 #if (DYSODEBUG == 2)
-                            printf("[UpdateWorkerThread] Sent update of %u-th bin\n", ntohl(data->index_update));
+                            printf("[UpdateWorkerThread] Sent update of %u-th bin (seq %u)\n", ntohl(data->index_update) & (REG_LEN_KEY - 1),
+                                   ntohl(data->index_update) >> UPDATE_SEQ_SHIFT);
 #endif
-                            m_WorkerConfig.sendPacketTo->sendPacket(parsedPacket, txQueueId, false);
                             success_dequeue = true;
-                            nRoundRobin = (i + 1) % NUM_DYSO_WORKER;
+                            counters.nMsgs++;
+                            nRoundRobin = (j + 1) % nUpdateQueue;
                             break;
                         }
                     }
@@ -126,16 +168,41 @@ class UpdateWorkerThread : public pcpp::DpdkWorkerThread {
                     // if failed to dequeue (i.e., nothing to update)
                     if (!success_dequeue) {
 #if (DYSODEBUG == 2)
-                            printf("[UpdateWorkerThread] Nothing to update, use dummy: index_update=7777777\n");
-#endif                  
-                        data->index_update = htonl(7777777);
-                        m_WorkerConfig.sendPacketTo->sendPacket(parsedPacket, txQueueId, false);
+                        printf("[UpdateWorkerThread] Nothing to update, use dummy: index_update=7777777\n");
+#endif
+                        data->index_update = htonl(DEFAULT_EMPTY_VALUE);
                     }
 
+                    txPacketArr[packetsToSend++] = packetArr[i];
                     totalCount++;
                 }
             }
 
+            /* step 3. send back all rewritten packets at once (one TX burst) */
+            if (packetsToSend > 0) {
+                packetsSent = m_WorkerConfig.sendPacketTo->sendPackets(txPacketArr, packetsToSend, txQueueId, false);
+                totalDropped += packetsToSend - packetsSent;  // lost UPDATEs are retransmitted at timeout (see DysoWorker::expireUpdates)
+            }
+
+#if (DYSO_IDLE_PARK == 1)
+            /* back off while the NIC queue is empty (UPDATEs wait in SPSCTxQueues for packets anyway) */
+            if (packetsReceived > 0)
+                backoff.reset();
+            else if (backoff.idle())
+                usleep(IDLE_NIC_SLEEP_US);
+#endif
+
+            /* publish telemetry (see Telemetry_multicore.h) */
+            counters.nPkts += packetsReceived;
+            if (telemetry.due(start_ts_per_batch)) {
+                counters.nDropped = totalDropped;
+                counters.ringOccupancy = 0;
+                for (uint32_t i = 0; i < nUpdateQueue; i++)
+                    counters.ringOccupancy += m_updateQueue[i]->size();
+                counters.nParked = backoff.getNumPark();
+                telemetry.publish(counters, start_ts_per_batch);
+            }
+
             /* LOGGING TIMESTAMP */
             if (packetsReceived > 0) {
                 finish_ts_per_batch = std::chrono::steady_clock::now();
@@ -145,7 +212,7 @@ class UpdateWorkerThread : public pcpp::DpdkWorkerThread {
             }
 
             if (total_number_of_pkts > 1000000) { // 1 Million Pkts
-                printf("[UpdateWorkerThread] Avg time to process 1 pkt: %lu (ns)\n", total_elapsed_time / total_number_of_pkts);
+                printf("[UpdateWorkerThread %u] Avg time to process 1 pkt: %lu (ns), TX dropped: %lu\n", updateIdx, total_elapsed_time / total_number_of_pkts, totalDropped);
                 total_number_of_pkts = 0;
                 total_elapsed_time = 0;
             }
@@ -4,8 +4,12 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stddef.h>
+#include <string.h>
 
-inline static uint32_t crc32_sw(const uint8_t *s,size_t n) {
+// width=32 poly=0x04c11db7 init=0xffffffff refin=true refout=true xorout=0xffffffff check=0xcbf43926 name="CRC-32" (Tofino CRC32)
+
+/* bit-by-bit reference (for self-check) */
+inline static uint32_t crc32_sw_bitwise(const uint8_t *s,size_t n) {
 	uint32_t crc=0xFFFFFFFF;
 	
 	for(size_t i=0;i<n;i++) {
@@ -19,4 +23,49 @@ inline static uint32_t crc32_sw(const uint8_t *s,size_t n) {
 	}
 	
 	return ~crc;
-}
\ No newline at end of file
+}
+
+/* slicing-by-8 tables (reflected), table[k][i] : crc of byte i followed by k zero bytes */
+struct Crc32Table {
+	uint32_t t[8][256];
+};
+constexpr Crc32Table makeCrc32Table() {
+	Crc32Table table{};
+	for(uint32_t i=0;i<256;i++) {
+		uint32_t crc=i;
+		for(int j=0;j<8;j++)
+			crc=(crc>>1)^((0-(crc&1))&0xEDB88320);
+		table.t[0][i]=crc;
+	}
+	for(int k=1;k<8;k++)
+		for(uint32_t i=0;i<256;i++)
+			table.t[k][i]=(table.t[k-1][i]>>8)^table.t[0][table.t[k-1][i]&0xFF];
+	return table;
+}
+inline constexpr Crc32Table CRC32_TABLE = makeCrc32Table();
+
+inline static uint32_t crc32_sw(const uint8_t *s,size_t n) {
+	const auto& t=CRC32_TABLE.t;
+	uint32_t crc=0xFFFFFFFF;
+	
+	// 8 bytes at once (little-endian host)
+	for(;n>=8;n-=8,s+=8) {
+		uint32_t one,two;
+		memcpy(&one,s,4);
+		memcpy(&two,s+4,4);
+		one^=crc;
+		crc=t[7][one&0xFF]^t[6][(one>>8)&0xFF]^t[5][(one>>16)&0xFF]^t[4][one>>24]^
+		    t[3][two&0xFF]^t[2][(two>>8)&0xFF]^t[1][(two>>16)&0xFF]^t[0][two>>24];
+	}
+	for(;n>0;n--,s++)
+		crc=(crc>>8)^t[0][(crc^*s)&0xFF];
+	
+	return ~crc;
+}
+
+/* 4-byte key, given as stored in memory (e.g., network-endian IPv4 address), little-endian host */
+inline static uint32_t crc32_sw_u32(const uint32_t& key) {
+	const auto& t=CRC32_TABLE.t;
+	uint32_t one=key^0xFFFFFFFF;
+	return ~(t[3][one&0xFF]^t[2][(one>>8)&0xFF]^t[1][(one>>16)&0xFF]^t[0][one>>24]);
+}
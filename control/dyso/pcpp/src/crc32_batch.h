@@ -0,0 +1,154 @@
+#pragma once
+
+#include <immintrin.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "crc32.h"
+#include "crc32mpeg.h"
+
+/**
+ * CRCs of many 4-byte keys at once, i.e., (crc32_mpeg, crc32) of IPv4 addresses as in dyso_pipe1.p4
+ *  -- meta.hash_crc32_mpeg : CRC-32/MPEG-2 -> row (dyso index)
+ *  -- meta.hash_crc32      : CRC-32        -> 26-bit hashkey
+ *
+ * Two implementations, one is selected at runtime by CPU support and a short calibration (crc32BatchSelect):
+ *  -- table : slicing tables of crc32.h / crc32mpeg.h (8 lookups per key, interleaved across keys)
+ *  -- clmul : PCLMULQDQ Barrett reduction. Both CRCs share the polynomial 0x04C11DB7 with init 0xFFFFFFFF,
+ *             and CRC-32 is the bit-reflection of MPEG-2, i.e., crc32(w) = ~rev(mpeg(rev(w))) for a 4-byte word w.
+ * Note: SSE4.2 crc32 instruction is CRC-32C (poly 0x1EDC6F41), which is not what Tofino computes, so is not used.
+ * Both must be bit-exact with the bitwise references (see crc32BatchSelfCheck).
+ */
+
+/* Barrett constants: mu = floor(x^64 / P), P = x^32 + 0x04C11DB7 */
+constexpr uint64_t crc32BarrettMu() {
+    // long division of x^64 by P over GF(2)
+    uint64_t quotient = 0;
+    unsigned __int128 rem = (unsigned __int128)1 << 64;
+    const unsigned __int128 poly = ((unsigned __int128)1 << 32) | 0x04C11DB7;
+    for (int shift = 32; shift >= 0; shift--) {
+        if ((rem >> (32 + shift)) & 1) {
+            rem ^= poly << shift;
+            quotient |= uint64_t(1) << shift;
+        }
+    }
+    return quotient;
+}
+constexpr uint64_t CRC32_BARRETT_MU = crc32BarrettMu();  // 33 bits
+constexpr uint64_t CRC32_BARRETT_POLY = 0x04C11DB7;      // lower 32 bits of P
+
+inline uint32_t crc32BitReverse(uint32_t x) {
+    x = __builtin_bswap32(x);
+    x = ((x & 0x0F0F0F0F) << 4) | ((x >> 4) & 0x0F0F0F0F);
+    x = ((x & 0x33333333) << 2) | ((x >> 2) & 0x33333333);
+    x = ((x & 0x55555555) << 1) | ((x >> 1) & 0x55555555);
+    return x;
+}
+
+/* table : 4 keys interleaved to overlap lookups */
+inline void crc32BatchTable(const uint32_t* keys, size_t n, uint32_t* mpeg, uint32_t* sw) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        uint32_t m0 = crc32_mpeg_u32(keys[i]), m1 = crc32_mpeg_u32(keys[i + 1]);
+        uint32_t m2 = crc32_mpeg_u32(keys[i + 2]), m3 = crc32_mpeg_u32(keys[i + 3]);
+        uint32_t s0 = crc32_sw_u32(keys[i]), s1 = crc32_sw_u32(keys[i + 1]);
+        uint32_t s2 = crc32_sw_u32(keys[i + 2]), s3 = crc32_sw_u32(keys[i + 3]);
+        mpeg[i] = m0, mpeg[i + 1] = m1, mpeg[i + 2] = m2, mpeg[i + 3] = m3;
+        sw[i] = s0, sw[i + 1] = s1, sw[i + 2] = s2, sw[i + 3] = s3;
+    }
+    for (; i < n; i++) {
+        mpeg[i] = crc32_mpeg_u32(keys[i]);
+        sw[i] = crc32_sw_u32(keys[i]);
+    }
+}
+
+/* clmul : (w * x^32) mod P for two 32-bit words w (non-reflected, init is given as xor of w) */
+__attribute__((target("pclmul,sse4.1"))) inline __m128i crc32BarrettClmul(const __m128i& w) {
+    const __m128i k = _mm_set_epi64x(CRC32_BARRETT_POLY, CRC32_BARRETT_MU);
+    __m128i q0 = _mm_srli_epi64(_mm_clmulepi64_si128(w, k, 0x00), 32);  // floor(w0 * mu / x^32)
+    __m128i q1 = _mm_srli_epi64(_mm_clmulepi64_si128(w, k, 0x01), 32);  // floor(w1 * mu / x^32)
+    __m128i r0 = _mm_clmulepi64_si128(q0, k, 0x10);                     // q0 * P
+    __m128i r1 = _mm_clmulepi64_si128(q1, k, 0x10);                     // q1 * P
+    return _mm_unpacklo_epi64(r0, r1);                                  // lower 32 bits are CRCs
+}
+
+__attribute__((target("pclmul,sse4.1"))) inline void crc32BatchClmul(const uint32_t* keys, size_t n, uint32_t* mpeg, uint32_t* sw) {
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        uint32_t host0 = ntohl(keys[i]), host1 = ntohl(keys[i + 1]);
+        __m128i wm = _mm_set_epi64x(host1 ^ 0xFFFFFFFF, host0 ^ 0xFFFFFFFF);
+        __m128i ws = _mm_set_epi64x(crc32BitReverse(keys[i + 1]) ^ 0xFFFFFFFF, crc32BitReverse(keys[i]) ^ 0xFFFFFFFF);
+        __m128i rm = crc32BarrettClmul(wm);
+        __m128i rs = crc32BarrettClmul(ws);
+        mpeg[i] = uint32_t(_mm_cvtsi128_si32(rm));
+        mpeg[i + 1] = uint32_t(_mm_extract_epi32(rm, 2));
+        sw[i] = ~crc32BitReverse(uint32_t(_mm_cvtsi128_si32(rs)));
+        sw[i + 1] = ~crc32BitReverse(uint32_t(_mm_extract_epi32(rs, 2)));
+    }
+    if (i < n)
+        crc32BatchTable(keys + i, n - i, mpeg + i, sw + i);
+}
+
+/**
+ * (crc32_mpeg, crc32) of n 4-byte keys, each given as stored in memory (e.g., network-endian IPv4 address).
+ * The implementation is selected at the first call (see crc32BatchSelect).
+ */
+typedef void (*Crc32BatchFunc)(const uint32_t*, size_t, uint32_t*, uint32_t*);
+
+inline bool crc32BatchSelfCheck(const Crc32BatchFunc& func) {
+    const uint8_t check[] = "123456789";
+    if (crc32_sw(check, 9) != 0xCBF43926 || crc32_mpeg(check, 9) != 0x0376E6E7 ||
+        crc32_sw_bitwise(check, 9) != 0xCBF43926 || crc32_mpeg_bitwise(check, 9) != 0x0376E6E7)
+        return false;
+
+    uint32_t keys[67], mpeg[67], sw[67];
+    uint32_t x = 0x12345678;
+    for (size_t i = 0; i < 67; i++) {
+        x = x * 1664525 + 1013904223;
+        keys[i] = (i < 3) ? uint32_t(0 - i) : x;  // with 0xFFFFFFFF, 0xFFFFFFFE
+    }
+    keys[3] = 0;
+    func(keys, 67, mpeg, sw);
+    for (size_t i = 0; i < 67; i++) {
+        const uint8_t* bytes = (const uint8_t*)&keys[i];
+        if (mpeg[i] != crc32_mpeg_bitwise(bytes, 4) || sw[i] != crc32_sw_bitwise(bytes, 4) ||
+            mpeg[i] != crc32_mpeg(bytes, 4) || sw[i] != crc32_sw(bytes, 4))
+            return false;
+    }
+    return true;
+}
+
+/* elapsed time (ns) of func over a few batches of 4096 keys */
+inline uint64_t crc32BatchCalibrate(const Crc32BatchFunc& func) {
+    static uint32_t keys[4096], mpeg[4096], sw[4096];
+    for (uint32_t i = 0; i < 4096; i++)
+        keys[i] = i * 2654435761u;
+    uint64_t best = UINT64_MAX;
+    for (int trial = 0; trial < 5; trial++) {
+        auto start = std::chrono::steady_clock::now();
+        func(keys, 4096, mpeg, sw);
+        best = std::min(best, uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()));
+    }
+    return best;
+}
+
+inline Crc32BatchFunc crc32BatchSelect() {
+    if (!crc32BatchSelfCheck(crc32BatchTable)) {
+        fprintf(stderr, "[CRC] Self-check of CRC tables failed\n");
+        exit(1);
+    }
+    // PCLMULQDQ is not always faster than L1-resident tables for 4-byte keys
+    if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1") && crc32BatchSelfCheck(crc32BatchClmul) &&
+        crc32BatchCalibrate(crc32BatchClmul) < crc32BatchCalibrate(crc32BatchTable))
+        return crc32BatchClmul;
+    return crc32BatchTable;
+}
+
+inline void crc32Batch(const uint32_t* keys, size_t n, uint32_t* mpeg, uint32_t* sw) {
+    static const Crc32BatchFunc func = crc32BatchSelect();
+    func(keys, n, mpeg, sw);
+}
@@ -3,9 +3,13 @@
 // #include <x86intrin.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
+#include <arpa/inet.h>
 
 // width=32 poly=0x04c11db7 init=0xffffffff refin=false refout=false xorout=0x00000000 check=0x0376e6e7 residue=0x00000000 name="CRC-32/MPEG-2"
-inline static uint32_t crc32_mpeg(uint8_t *val, int l) {
+
+/* bit-by-bit reference (for self-check) */
+inline static uint32_t crc32_mpeg_bitwise(const uint8_t *val, int l) {
    int i, j;
    uint32_t crc, msb;
 
@@ -22,3 +26,48 @@ inline static uint32_t crc32_mpeg(uint8_t *val, int l) {
    // don't complement crc on output
    return crc;         
 }
+
+/* slicing-by-8 tables (non-reflected), table[k][i] : crc of byte i followed by k zero bytes */
+struct Crc32MpegTable {
+   uint32_t t[8][256];
+};
+constexpr Crc32MpegTable makeCrc32MpegTable() {
+   Crc32MpegTable table{};
+   for(uint32_t i = 0; i < 256; i++) {
+      uint32_t crc = i << 24;
+      for (int j = 0; j < 8; j++)
+         crc = (crc << 1) ^ ((0 - (crc >> 31)) & 0x04C11DB7);
+      table.t[0][i] = crc;
+   }
+   for(int k = 1; k < 8; k++)
+      for(uint32_t i = 0; i < 256; i++)
+         table.t[k][i] = (table.t[k-1][i] << 8) ^ table.t[0][table.t[k-1][i] >> 24];
+   return table;
+}
+inline constexpr Crc32MpegTable CRC32_MPEG_TABLE = makeCrc32MpegTable();
+
+inline static uint32_t crc32_mpeg(const uint8_t *val, int l) {
+   const auto& t = CRC32_MPEG_TABLE.t;
+   uint32_t crc = 0xFFFFFFFF;
+
+   // 8 bytes at once (big-endian words)
+   for(; l >= 8; l -= 8, val += 8) {
+      uint32_t one, two;
+      memcpy(&one, val, 4);
+      memcpy(&two, val + 4, 4);
+      one = ntohl(one) ^ crc;
+      two = ntohl(two);
+      crc = t[7][one>>24] ^ t[6][(one>>16)&0xFF] ^ t[5][(one>>8)&0xFF] ^ t[4][one&0xFF] ^
+            t[3][two>>24] ^ t[2][(two>>16)&0xFF] ^ t[1][(two>>8)&0xFF] ^ t[0][two&0xFF];
+   }
+   for(; l > 0; l--, val++)
+      crc = (crc << 8) ^ t[0][(crc >> 24) ^ *val];
+   return crc;
+}
+
+/* 4-byte key, given as stored in memory (e.g., network-endian IPv4 address) */
+inline static uint32_t crc32_mpeg_u32(const uint32_t& key) {
+   const auto& t = CRC32_MPEG_TABLE.t;
+   uint32_t one = ntohl(key) ^ 0xFFFFFFFF;
+   return t[3][one>>24] ^ t[2][(one>>16)&0xFF] ^ t[1][(one>>8)&0xFF] ^ t[0][one&0xFF];
+}
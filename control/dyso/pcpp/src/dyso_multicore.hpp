@@ -3,11 +3,13 @@
 #include <arpa/inet.h>
 #include <stdio.h>
 
+#include <algorithm>
+#include <array>
 #include <memory>
 /* utils */
 #include "crc32.h"
 #include "crc32mpeg.h"
-#include "robin_hood.h"
+#include "mphf.h"
 #include "utils_header.h"
 #include "utils_log.h"
 #include "utils_macro_multicore.h"
@@ -15,15 +17,37 @@
 /*
  * Dyso Configuration
  * For simplicity, we assume Keyfield is uint32_t (4 Byte) and no data part
- * We use Robin-hood hash table.
+ * Nodes are looked up by a per-worker open-addressed index (NodeIndex).
  */
 #define N_HEAD (10)  // number of heads (can be larger if you want)
 
+/**
+ * Fixed-point counter of Node, relative to its head's frequency, in units of 1/2^(N_HEAD-1).
+ * A head of idx i adds 1/2^i per count, i.e., (1 << (N_HEAD - 1 - i)) units, so promotion is shifts and adds,
+ * and results are bit-exact between main policy and replicas.
+ */
+#define COUNT_FRAC_BIT (N_HEAD - 1)     // fractional bits of counter
+#define COUNT_ONE (1u << COUNT_FRAC_BIT)  // 1.0
+
 /* macro functions */
-#define OVERFLOW(X) (X >= 1.0)                                                 // true if value >= 1.0
-#define UNDERFLOW(X) (X < 1.0)                                                 // true if value < 1.0
+#define OVERFLOW(X) (X >= COUNT_ONE)                                           // true if value >= 1.0
+#define UNDERFLOW(X) (X < COUNT_ONE)                                           // true if value < 1.0
+#define COUNT_TO_DOUBLE(X) (double(X) / COUNT_ONE)                             // for logging
+#define GET_UNIT_SHIFT(idx) (COUNT_FRAC_BIT - (idx))                           // unit to add count at head idx (1 << shift)
 #define GET_HEAD_IDX(count) (std::min(31 - __builtin_clz(count), N_HEAD - 1))  // get head index from count
 
+/**
+ * Node -> Head link without reference counting.
+ * Each Dyso counts its agings (epoch), and a node keeps "epoch + head index" at the time it is pushed to a head (gen).
+ *  -- head index = gen - epoch, if gen >= epoch
+ *  -- expired to backing head (idx=-1), if gen < epoch (e.g., gen=0 for nodes never counted)
+ * Before the epoch wraps around, all gens of the Dyso are rebased (once per ~4B agings).
+ */
+#define HEAD_GEN_BACKING (0)                         // gen of nodes at backing head
+#define HEAD_EPOCH_INIT (1)                          // initial aging epoch
+#define HEAD_EPOCH_REBASE (UINT32_MAX - 2 * N_HEAD)  // rebase gens before the epoch wraps around
+static_assert(N_HEAD <= 32, "non-empty head bitmap of Dyso is 32-bit");
+
 /**
  * 14-bit dyso index (crc32_mpeg)    | 26-bit hashkey (crc32)
  *             ||
@@ -35,310 +59,806 @@
 class Node;
 class Head;
 
+/* index of Node in NodePool (instead of pointer) */
+typedef uint32_t NodeHandle;
+constexpr NodeHandle NODE_NULL = UINT32_MAX;
+
 class Node {
    public:
     /* rule */
     uint32_t key_;  // Big-Endian (Network)
 
     /* cache status */
-    double count_;   // relative count to its head's freq, [0, 1)
-    uint8_t cache_;  // 1 if in cache, otherwise 0
+    uint32_t count_;  // relative count to its head's freq, [0, 1) in fixed-point (see COUNT_ONE)
+    uint8_t cache_;   // 1 if in cache, otherwise 0
 
-    /* pointer to next/prev Node */
-    struct Node* next_;
-    struct Node* prev_;
+    /* handle to next/prev Node */
+    NodeHandle next_;
+    NodeHandle prev_;
 
-    /* shared & weak pointer to Head */
-    std::weak_ptr<Head> wHead_;
+    /* link to Head (aging epoch + head index), see HEAD_GEN_BACKING */
+    uint32_t headGen_;
 
-    Node(const uint32_t& key) : count_(0.0), cache_(0), next_(nullptr), prev_(nullptr) {
+    Node(const uint32_t& key) : count_(0), cache_(0), next_(NODE_NULL), prev_(NODE_NULL), headGen_(HEAD_GEN_BACKING) {
         key_ = key;
     }
     ~Node() {}
 };
 
+/**
+ * Per-worker slab of Nodes.
+ * Nodes are allocated in bulk at startup (see DysoWorker::addDefaultNodes) so that nodes of the same row
+ * are contiguous, and linked by 32-bit handles. Released nodes are recycled via a free list (linked by next_).
+ */
+class NodePool {
+   private:
+    std::vector<Node> nodes_;
+    NodeHandle freeList_;  // head of released nodes
+
+   public:
+    NodePool() : freeList_(NODE_NULL) {}
+    ~NodePool() {}
+
+    /* bulk allocation, e.g., before adding default nodes */
+    void reserve(const size_t& n) { nodes_.reserve(n); }
+
+    /* Note: the returned handle is valid until release, but references (Node&) are not stable across alloc */
+    NodeHandle alloc(const uint32_t& key) {
+        NodeHandle h;
+        if (freeList_ != NODE_NULL) {
+            h = freeList_;
+            freeList_ = nodes_[h].next_;
+            nodes_[h] = Node(key);
+        } else {
+            h = NodeHandle(nodes_.size());
+            assert(h != NODE_NULL);
+            nodes_.emplace_back(key);
+        }
+        return h;
+    }
+    void release(const NodeHandle& h) {
+        nodes_[h].next_ = freeList_;
+        freeList_ = h;
+    }
+
+    /* Accessor */
+    Node& operator[](const NodeHandle& h) { return nodes_[h]; }
+    const Node& operator[](const NodeHandle& h) const { return nodes_[h]; }
+    size_t size() const { return nodes_.size(); }
+};
+
+/**
+ * Per-worker index of nodes, keyed by (row, 26-bit hashkey), instead of one hash map per Dyso.
+ * Open addressing with linear probing over one huge-page-backed array of compact slots,
+ * sized once at startup (see DysoWorker::addDefaultNodes), so a lookup is mostly a single probe.
+ * The row is the index of Dyso, which is unique among the policies sharing a NodePool.
+ *
+ * Optionally (see DYSO_NODE_MPHF), the nodes installed at startup are moved to a static part (buildPerfectHash),
+ * a dense array of slots placed by a minimal perfect hash, so a lookup is one slot without probing.
+ * The slot keeps (row, hashkey) to detect unknown keys, and nodes registered afterwards go to the dynamic part.
+ */
+class NodeIndex {
+   private:
+    struct Slot {
+        uint32_t row;
+        uint32_t hashkey;
+        NodeHandle node;  // NODE_NULL if empty
+    };
+    Slot* slots_ = nullptr;
+    uint64_t mask_ = 0;   // capacity - 1 (capacity is power of two)
+    uint32_t shift_ = 0;  // 64 - log2(capacity)
+    uint64_t size_ = 0;
+
+    /* static part (see buildPerfectHash) */
+    PerfectHash mphf_;
+    Slot* staticSlots_ = nullptr;
+    uint64_t nStatic_ = 0;      // number of static slots
+    uint64_t nStaticLive_ = 0;  // number of static slots not erased
+
+    static constexpr uint64_t MIN_CAPACITY = 1024;
+
+    static uint64_t keyOf(const uint32_t& row, const uint32_t& hashkey) { return (uint64_t(row) << 32) | hashkey; }
+
+    /* static slot of (row, hashkey), nullptr if unknown */
+    Slot* findStatic(const uint32_t& row, const uint32_t& hashkey) const {
+        if (nStatic_ == 0)
+            return nullptr;
+        Slot* slot = &staticSlots_[mphf_.lookup(keyOf(row, hashkey))];
+        return (slot->hashkey == hashkey && slot->row == row) ? slot : nullptr;
+    }
+
+    /* max load factor 3/4 */
+    static uint64_t capacityFor(const uint64_t& n) {
+        uint64_t cap = MIN_CAPACITY;
+        while (cap * 3 < n * 4)
+            cap <<= 1;
+        return cap;
+    }
+
+    /* home slot (Fibonacci hashing of row and hashkey) */
+    uint64_t homeOf(const uint32_t& row, const uint32_t& hashkey) const {
+        return (((uint64_t(row) << 32) | hashkey) * 0x9E3779B97F4A7C15ull) >> shift_;
+    }
+
+    void rehash(const uint64_t& capacity, const bool& keepSlots = true) {
+        Slot* oldSlots = slots_;
+        uint64_t oldCapacity = (oldSlots != nullptr) ? mask_ + 1 : 0;
+
+        slots_ = hugepage_mmap<Slot>(capacity);
+        if (slots_ == nullptr) {
+            std::cerr << "[NodeIndex] Failed to allocate " << capacity << " slots" << std::endl;
+            exit(1);
+        }
+        for (uint64_t i = 0; i < capacity; i++)
+            slots_[i].node = NODE_NULL;
+        mask_ = capacity - 1;
+        shift_ = 64 - __builtin_ctzll(capacity);
+        size_ = 0;
+
+        for (uint64_t i = 0; i < oldCapacity && keepSlots; i++) {
+            if (oldSlots[i].node != NODE_NULL)
+                insert(oldSlots[i].row, oldSlots[i].hashkey, oldSlots[i].node);
+        }
+        if (oldSlots != nullptr)
+            hugepage_munmap(oldSlots, oldCapacity);
+    }
+
+   public:
+    NodeIndex() { rehash(MIN_CAPACITY); }
+    ~NodeIndex() {
+        hugepage_munmap(slots_, mask_ + 1);
+        if (staticSlots_ != nullptr)
+            hugepage_munmap(staticSlots_, nStatic_);
+    }
+
+    // slots are owned by this object
+    NodeIndex(const NodeIndex&) = delete;
+    NodeIndex& operator=(const NodeIndex&) = delete;
+
+    /* bulk allocation, e.g., before adding default nodes */
+    void reserve(const uint64_t& n) {
+        uint64_t cap = capacityFor(n);
+        if (cap > mask_ + 1)
+            rehash(cap);
+    }
+
+    /**
+     * move all nodes to the static part, built by a minimal perfect hash (e.g., after adding default nodes).
+     * Return false (and keep the nodes in the dynamic part) if it fails to build.
+     */
+    bool buildPerfectHash() {
+        std::vector<Slot> entries;
+        entries.reserve(size());
+        for (uint64_t i = 0; i < nStatic_; i++) {
+            if (staticSlots_[i].node != NODE_NULL)
+                entries.push_back(staticSlots_[i]);
+        }
+        for (uint64_t i = 0; i <= mask_; i++) {
+            if (slots_[i].node != NODE_NULL)
+                entries.push_back(slots_[i]);
+        }
+        std::vector<uint64_t> keys(entries.size());
+        for (size_t i = 0; i < entries.size(); i++)
+            keys[i] = keyOf(entries[i].row, entries[i].hashkey);
+
+        PerfectHash mphf;
+        if (!mphf.build(keys)) {
+            std::cerr << "[NodeIndex] Failed to build perfect hash of " << keys.size() << " keys" << std::endl;
+            return false;
+        }
+        Slot* staticSlots = hugepage_mmap<Slot>(std::max(keys.size(), size_t(1)));
+        if (staticSlots == nullptr) {
+            std::cerr << "[NodeIndex] Failed to allocate " << keys.size() << " static slots" << std::endl;
+            return false;
+        }
+        for (size_t i = 0; i < entries.size(); i++)
+            staticSlots[mphf.lookup(keys[i])] = entries[i];
+
+        // swap to the new static part, and empty the dynamic part
+        if (staticSlots_ != nullptr)
+            hugepage_munmap(staticSlots_, nStatic_);
+        mphf_ = std::move(mphf);
+        staticSlots_ = staticSlots;
+        nStatic_ = nStaticLive_ = entries.size();
+        rehash(MIN_CAPACITY, false);
+        return true;
+    }
+
+    /* return NODE_NULL if not found */
+    NodeHandle find(const uint32_t& row, const uint32_t& hashkey) const {
+        const Slot* slot = findStatic(row, hashkey);
+        if (slot != nullptr)
+            return slot->node;  // NODE_NULL if erased
+        if (size_ == 0)
+            return NODE_NULL;
+        for (uint64_t i = homeOf(row, hashkey);; i = (i + 1) & mask_) {
+            if (slots_[i].node == NODE_NULL)
+                return NODE_NULL;
+            if (slots_[i].hashkey == hashkey && slots_[i].row == row)
+                return slots_[i].node;
+        }
+    }
+
+    /* prefetch the home slot of (row, hashkey), e.g., ahead of bulk inserts */
+    void prefetch(const uint32_t& row, const uint32_t& hashkey) const {
+        if (slots_ != nullptr)
+            __builtin_prefetch(&slots_[homeOf(row, hashkey)], 1);
+    }
+
+    /* insert or overwrite */
+    void insert(const uint32_t& row, const uint32_t& hashkey, const NodeHandle& node) {
+        Slot* slot = findStatic(row, hashkey);
+        if (slot != nullptr) {
+            nStaticLive_ += (slot->node == NODE_NULL) ? 1 : 0;
+            slot->node = node;
+            return;
+        }
+        if ((size_ + 1) * 4 > (mask_ + 1) * 3)
+            rehash((mask_ + 1) << 1);
+        for (uint64_t i = homeOf(row, hashkey);; i = (i + 1) & mask_) {
+            Slot& slot = slots_[i];
+            if (slot.node == NODE_NULL) {
+                slot = {row, hashkey, node};
+                size_++;
+                return;
+            }
+            if (slot.hashkey == hashkey && slot.row == row) {
+                slot.node = node;
+                return;
+            }
+        }
+    }
+
+    /* erase with backward shift (no tombstone), return false if not found */
+    bool erase(const uint32_t& row, const uint32_t& hashkey) {
+        Slot* slot = findStatic(row, hashkey);
+        if (slot != nullptr && slot->node != NODE_NULL) {
+            slot->node = NODE_NULL;  // keep (row, hashkey) to be re-inserted
+            nStaticLive_--;
+            return true;
+        }
+        uint64_t i = homeOf(row, hashkey);
+        for (;; i = (i + 1) & mask_) {
+            if (slots_[i].node == NODE_NULL)
+                return false;
+            if (slots_[i].hashkey == hashkey && slots_[i].row == row)
+                break;
+        }
+        for (uint64_t j = (i + 1) & mask_; slots_[j].node != NODE_NULL; j = (j + 1) & mask_) {
+            // move slot j to the hole i, unless its home is in (i, j]
+            uint64_t home = homeOf(slots_[j].row, slots_[j].hashkey);
+            if (((j - home) & mask_) >= ((j - i) & mask_)) {
+                slots_[i] = slots_[j];
+                i = j;
+            }
+        }
+        slots_[i].node = NODE_NULL;
+        size_--;
+        return true;
+    }
+
+    /* Accessor */
+    uint64_t size() const { return size_ + nStaticLive_; }
+    uint64_t capacity() const { return mask_ + 1; }
+    uint64_t sizeStatic() const { return nStatic_; }
+    uint64_t sizePerfectHashInBits() const { return mphf_.sizeInBits(); }
+};
+
+/**
+ * Admission filter of unknown keys for on-demand registration (see DYSO_NODE_ON_DEMAND), one per worker.
+ * Each local row has a tiny count-min sketch (depth 2 x width 64, 8-bit counters, conservative update) over hashkeys,
+ * which admits a key seen ON_DEMAND_ADMIT_COUNT times. Counters of a row are halved every ON_DEMAND_FILTER_RESET
+ * signatures of the row, so one-hit keys (e.g., scans) do not take nodes.
+ */
+class AdmissionFilter {
+   private:
+    static constexpr uint32_t WIDTH = 64;
+    struct Row {
+        uint8_t counters[2][WIDTH];
+        uint32_t nSeen;
+    };
+    std::vector<Row> rows_;
+
+   public:
+    AdmissionFilter() {}
+    ~AdmissionFilter() {}
+
+    void init(const uint32_t& nRows) { rows_.assign(nRows, Row{}); }
+    void resize(const uint32_t& nRows) { rows_.resize(nRows, Row{}); }
+    void reset(const uint32_t& localRow) { rows_[localRow] = Row{}; }
+
+    /* count the hashkey at local row, return true if admitted */
+    bool admit(const uint32_t& localRow, const uint32_t& hashkey) {
+        Row& row = rows_[localRow];
+        uint8_t& c0 = row.counters[0][hashkey & (WIDTH - 1)];
+        uint8_t& c1 = row.counters[1][(hashkey >> 6) & (WIDTH - 1)];
+        uint8_t estimate = std::min(c0, c1);
+        if (estimate < UINT8_MAX) {
+            // conservative update : only the minimum counters
+            c0 += (c0 == estimate) ? 1 : 0;
+            c1 += (c1 == estimate) ? 1 : 0;
+            ++estimate;
+        }
+        if (++row.nSeen >= ON_DEMAND_FILTER_RESET) {
+            for (auto& counters : row.counters)
+                for (auto& counter : counters)
+                    counter >>= 1;
+            row.nSeen = 0;
+        }
+        return estimate >= ON_DEMAND_ADMIT_COUNT;
+    }
+};
+
+/**
+ * Head of nodes with the same log_freq.
+ * Its index (-1 : backing (freq=0), >=0 : log_freq) is given by its position in Dyso's head ring,
+ * and the unit to add count is GET_UNIT_SHIFT(idx), e.g., 0.125 for frequency 8.
+ */
 class Head {
    private:
-    int idx_;                // index of head (-1 : backing (freq=0), >=0 : log_freq)
-    double unitAdd_;         // unit to add count, e.g., 0.125 for frequency 8;
-    struct Node* nodelist_;  // double-linked list
+    NodeHandle nodelist_;  // double-linked list (in NodePool)
 
    public:
-    Head(const int& idx, const double& unitAdd) : idx_(idx), unitAdd_(unitAdd), nodelist_(nullptr) {}
+    Head() : nodelist_(NODE_NULL) {}
     ~Head() {}
 
     /* Accessor */
-    const int& getIdx() const { return idx_; }
-    const double& getUnitAdd() const { return unitAdd_; }
-    Node* getNodeList() const { return nodelist_; }
-    void setNodeList(Node* node) { nodelist_ = node; }
+    NodeHandle getNodeList() const { return nodelist_; }
+    void setNodeList(const NodeHandle& node) { nodelist_ = node; }
 
     /* Mutator */
-    void aging() {
-        --idx_;
-        unitAdd_ = unitAdd_ * 2;
-    }
-    void pushNode(Node* node) {
-        if (nodelist_ == nullptr) {
+    void pushNode(NodePool& pool, const NodeHandle& h) {
+        Node& node = pool[h];
+        if (nodelist_ == NODE_NULL) {
             // if empty list
-            node->prev_ = node;
-            node->next_ = nullptr;
-            nodelist_ = node;
+            node.prev_ = h;
+            node.next_ = NODE_NULL;
+            nodelist_ = h;
         } else {
-            node->prev_ = nodelist_->prev_;
-            node->next_ = nodelist_;
-            nodelist_->prev_ = node;
-            nodelist_ = node;
+            Node& first = pool[nodelist_];
+            node.prev_ = first.prev_;
+            node.next_ = nodelist_;
+            first.prev_ = h;
+            nodelist_ = h;
         }
     }
 
     // pop node
-    void popNode(Node* node) {
-        if (nodelist_ == node) {
+    void popNode(NodePool& pool, const NodeHandle& h) {
+        Node& node = pool[h];
+        if (nodelist_ == h) {
             // pop from front
-            nodelist_ = node->next_;
-            if (nodelist_) {
-                nodelist_->prev_ = node->prev_;
+            nodelist_ = node.next_;
+            if (nodelist_ != NODE_NULL) {
+                pool[nodelist_].prev_ = node.prev_;
             }
-        } else if (nodelist_->prev_ == node) {
+        } else if (pool[nodelist_].prev_ == h) {
             // pop from end
-            node->prev_->next_ = node->next_;
-            nodelist_->prev_ = node->prev_;
+            pool[node.prev_].next_ = node.next_;
+            pool[nodelist_].prev_ = node.prev_;
         } else {
             // pop at middle
-            node->prev_->next_ = node->next_;
-            if (node->next_ != nullptr)
-                node->next_->prev_ = node->prev_;
+            pool[node.prev_].next_ = node.next_;
+            if (node.next_ != NODE_NULL)
+                pool[node.next_].prev_ = node.prev_;
         }
         /* Notice: The node's variables (prev/next/Head) will be set once allocated at its new Head. */
     }
 
     // pop and push front at the same Head
-    void popThenPushNode(Node* node) {
-        if (nodelist_ == node) {
+    void popThenPushNode(NodePool& pool, const NodeHandle& h) {
+        if (nodelist_ == h) {
             return;
         } else {
+            Node& node = pool[h];
+            Node& first = pool[nodelist_];
             // pop
-            node->prev_->next_ = node->next_;
-            if (nodelist_->prev_ == node)
-                nodelist_->prev_ = node->prev_;
-            else if (node->next_ != nullptr)
-                node->next_->prev_ = node->prev_;
+            pool[node.prev_].next_ = node.next_;
+            if (first.prev_ == h)
+                first.prev_ = node.prev_;
+            else if (node.next_ != NODE_NULL)
+                pool[node.next_].prev_ = node.prev_;
 
             // push
-            node->prev_ = nodelist_->prev_;
-            node->next_ = nodelist_;
-            nodelist_->prev_ = node;
-            nodelist_ = node;
+            node.prev_ = first.prev_;
+            node.next_ = nodelist_;
+            first.prev_ = h;
+            nodelist_ = h;
         }
     }
 
     // Logging
-    void printAll() {
-        cPrint("Dyso-PrintAll", "-- Head Idx: %d", idx_);
-        Node* node = nodelist_;
-        while (node != nullptr) {
-            std::shared_ptr<Head> sHead = node->wHead_.lock();
-            if (sHead) {
+    void printAll(const NodePool& pool, const int& idx) {
+        cPrint("Dyso-PrintAll", "-- Head Idx: %d", idx);
+        NodeHandle h = nodelist_;
+        while (h != NODE_NULL) {
+            const Node& node = pool[h];
+            if (idx >= 0) {
                 cPrint("Dyso-PrintAll", "Nodeinfo: [Head=%d] (%d) || Count: %.7f, Cache: %2d",
-                       sHead->getIdx(),
-                       ntohl(node->key_),
-                       node->count_,
-                       node->cache_);
+                       idx,
+                       ntohl(node.key_),
+                       COUNT_TO_DOUBLE(node.count_),
+                       node.cache_);
             } else {
                 cPrint("Dyso-PrintAll", "Nodeinfo: [Head=Expired] (%d) || Count: %.7f, Cache: %2d",
-                       ntohl(node->key_),
-                       node->count_,
-                       node->cache_);
+                       ntohl(node.key_),
+                       COUNT_TO_DOUBLE(node.count_),
+                       node.cache_);
             }
-            node = node->next_;
+            h = node.next_;
         }
 
-        if (nodelist_ != nullptr) {
-            node = nodelist_->prev_;
+        if (nodelist_ != NODE_NULL) {
+            const Node& node = pool[pool[nodelist_].prev_];
             cPrint("Dyso-PrintAll", "Last Node (nodelist->prev) : (%d) || Count: %.7f, Cache: %2d",
-                   ntohl(node->key_),
-                   node->count_,
-                   node->cache_);
+                   ntohl(node.key_),
+                   COUNT_TO_DOUBLE(node.count_),
+                   node.cache_);
         }
     }
 };
 
+/**
+ * Checkpoint records of a Dyso (see Checkpoint_multicore.h for the file layout).
+ * Nodes are recorded per head (idx=-1 first), each from its tail to front, so pushing them back restores the order.
+ * Gens are given by head indexes at restore, and cached nodes (cchActive_, cchUpdate_) by their ordinals in the records.
+ * The same records move a row between workers (see DysoWorker::exportRow), where the UPDATE in flight is kept.
+ * The sequence of UPDATEs is kept in both cases, so a late ACK of the recorded UPDATE is still recognized.
+ */
+struct CheckpointRow {
+    uint32_t idx;                     // index of Dyso
+    uint32_t agingPeriod;
+    uint64_t totalCount;
+    uint64_t unknownKey;
+    uint32_t virtHit;
+    uint32_t virtMiss;
+    uint32_t nNodes[N_HEAD + 1];      // number of nodes at head idx-1 (i.e., nNodes[0] : backing)
+    uint32_t cchActive[STAGE_CACHE];  // ordinal of the cached node, UINT32_MAX if empty
+    uint32_t cchUpdate[STAGE_CACHE];  // ordinal of the node in the UPDATE in flight, UINT32_MAX if empty
+    uint32_t updateInProgress;
+    uint32_t retransmitLeft;
+    uint32_t updateSeq;               // sequence of the last UPDATE (see UPDATE_SEQ_SHIFT)
+    uint32_t resync;                  // 1 if the cache of the data plane is unknown (see onUpdateTimeout)
+};
+
+struct CheckpointNode {
+    uint32_t key;      // Big-Endian (Network)
+    uint32_t hashkey;  // 26-bit hashkey
+    uint32_t count;
+    uint8_t cache;
+    uint8_t indexed;  // 0 if its (row, hashkey) is taken by another node
+    uint16_t reserved;
+};
+
 class Dyso {
    private:
     /* parameters */
     const uint32_t idx_;    // index of this Dyso object
     uint32_t agingPeriod_;  // aging period
     uint64_t totalCount_;   // total number of counts
+    uint32_t agingEpoch_;   // number of agings (see HEAD_GEN_BACKING)
 
     /* data */
-    robin_hood::unordered_flat_map<uint32_t, Node*> hashmap_;  // crc32 26bit hashkey -> node
-    std::vector<std::shared_ptr<Head>> heads_;
-    std::vector<Node*> cchActive_;
-    std::vector<Node*> cchUpdate_;
+    NodePool* pool_;    // per-worker slab of nodes
+    NodeIndex* index_;  // per-worker index, (idx_, crc32 26bit hashkey) -> node
+    Head backing_;           // idx=-1
+    Head heads_[N_HEAD];     // ring of heads, idx=i at (headBase_ + i) % N_HEAD
+    uint32_t headBase_;      // slot of idx=0, rotated by aging
+    uint32_t nonEmpty_;      // bitmap of non-empty heads (bit i : idx=i), shifted by aging
+    std::array<NodeHandle, STAGE_CACHE> cchActive_;
+    std::array<NodeHandle, STAGE_CACHE> cchUpdate_;
     bool replaceInProgress_;
 
-    /* SPSC queue to DPDK TX Worker */
+    /**
+     * top-STAGE_CACHE frontier (heads from the highest idx, recency order within a head), kept across misses.
+     * It is invalidated only if a node is pushed at or above the head of its last node (topKMinGen_),
+     * cache flags change, or nodes are added/removed. So a miss decision is O(1) in most cases.
+     */
+    std::array<NodeHandle, STAGE_CACHE> topK_;
+    uint32_t nTopK_;          // number of nodes in frontier (< STAGE_CACHE if the row is small)
+    uint32_t topKUncached_;   // number of nodes in frontier not in cache
+    uint32_t topKMinGen_;     // gen of the head of last node (HEAD_GEN_BACKING if it is not full, or at idx=-1)
+    bool topKValid_;
+
+    /* SPSC queue to DPDK TX Worker (shared by policies of a worker, nullptr for replicas) */
     qTxSPSC* updateQueue_ = nullptr;
 
+    /* signatures of unregistered keys (ignored as a miss) */
+    uint64_t unknownKey_ = 0;
+
+    /* lost UPDATE/ACK (see onUpdateTimeout) */
+    uint32_t updateSeq_ = 0;       // sequence of the last UPDATE, echoed by its ACK
+    uint32_t updatePos_ = 0;       // position of its last copy in updateQueue_
+    bool updateQueued_ = false;    // updatePos_ is valid (pushed by this object)
+    bool resync_ = false;          // an UPDATE was rolled back, so the data plane may hold cchActive_ or cchUpdate_
+    uint32_t retransmitLeft_ = 0;  // retransmissions left for the UPDATE in flight
+    uint64_t nTimeout_ = 0;        // UPDATEs without ACK until their deadline
+    uint64_t nRetransmit_ = 0;
+    uint64_t nRollback_ = 0;       // UPDATEs given up after UPDATE_MAX_RETRANSMIT
+    uint64_t nStaleAck_ = 0;       // ACKs of no UPDATE in flight (duplicated, superseded, or after restart)
+
+    /* number of nodes of this row (bounded by registerNode) */
+    uint32_t nNodes_ = 0;
+
     /* meta (only for replicas) */
     uint32_t virtHit_ = 0;   // virtual hit pkts
     uint32_t virtMiss_ = 0;  // virtual miss pkts
 
    public:
     Dyso(const uint32_t& idx,
-         const uint32_t& agingPeriod)
-        : idx_(idx), agingPeriod_(agingPeriod) {
-        // load shared-memory queue
-        updateQueue_ = getTxQueue(std::to_string(idx % NUM_DYSO_WORKER));
-
+         const uint32_t& agingPeriod,
+         NodePool& pool,
+         NodeIndex& index,
+         qTxSPSC* updateQueue = nullptr)
+        : idx_(idx), agingPeriod_(agingPeriod), pool_(&pool), index_(&index), updateQueue_(updateQueue) {
         // initialization
         totalCount_ = 0;
+        agingEpoch_ = HEAD_EPOCH_INIT;
+        headBase_ = 0;
+        nonEmpty_ = 0;
         replaceInProgress_ = false;
+        topKValid_ = false;
         // sanity check
         if (agingPeriod_ == 0) {
             std::invalid_argument("AgingPeriod should be larger than 0...");
             exit(1);
         }
 
-        // initialize heads
-        heads_.emplace_back(std::make_shared<Head>(Head(-1, 1.0)));
-        for (size_t idx = 0; idx < N_HEAD; idx++) {
-            heads_.emplace_back(std::move(std::make_shared<Head>(Head(idx, 1.0 / (1 << idx)))));
-        }
-        hashmap_.clear();
-        cchActive_.resize(STAGE_CACHE);
-        cchUpdate_.clear();
+        cchActive_.fill(NODE_NULL);
+        cchUpdate_.fill(NODE_NULL);
+        topK_.fill(NODE_NULL);
     }
     ~Dyso() {}
 
     void addDefaultNode(const uint32_t& key) {
         // input key is Big-Endian original key (Network-endian after htonl(.))
         // hashkey of 167772160 : 9309101 (26-bit)
+        uint32_t hashkey = crc32_sw_u32(key) & REG_MASK_GET_HASHKEY;  // lower 26-bits hashkey
+        addDefaultNode(key, hashkey);
+    }
 
-        Node* node = new Node(key);
-        heads_[0]->pushNode(node);  // add to head of idx=-1
+    /* with pre-computed hashkey (e.g., from KeyMap) */
+    void addDefaultNode(const uint32_t& key, const uint32_t& hashkey) {
+        NodeHandle node = pool_->alloc(key);
+        backing_.pushNode(*pool_, node);  // add to head of idx=-1
+        topKValid_ = false;
 
-        // add to hashmap
-        uint8_t segkey[4];
-        memcpy(segkey, (uint8_t*)(&key), 4);
-        uint32_t hashkey = crc32_sw(segkey, 4) & REG_MASK_GET_HASHKEY;  // lower 26-bits hashkey
-        hashmap_[hashkey] = node;
+        // add to index
+        index_->insert(idx_, hashkey, node);
+        ++nNodes_;
     }
 
     void removeNode(const uint32_t& key) {
         // input key is Big-Endian original key (network-endian after htonl(.))
-        Node* node;
-        try {
-            uint8_t segkey[4];
-            memcpy(segkey, (uint8_t*)(&key), 4);
-            uint32_t hashkey = crc32_sw(segkey, 4) & REG_MASK_GET_HASHKEY;
-            node = hashmap_.at(hashkey);
-        } catch (const std::out_of_range& oor) {
-            std::cerr << "[Dyso] Out of Range (removeNode): " << oor.what() << "\n";
+        NodeHandle node;
+        uint32_t hashkey = crc32_sw_u32(key) & REG_MASK_GET_HASHKEY;
+        if ((node = index_->find(idx_, hashkey)) == NODE_NULL) {
+            std::cerr << "[Dyso] Out of Range (removeNode): " << hashkey << "\n";
             exit(1);
         }
-        std::shared_ptr<Head> currPtr = node->wHead_.lock();
-        if (currPtr) {
-            currPtr->popNode(node);
-        } else {
-            heads_[0]->popNode(node);
+        removeNode(node, hashkey);
+    }
+
+    void removeNode(const NodeHandle& node, const uint32_t& hashkey) {
+        popNodeFromHead(getHeadIdx((*pool_)[node]), node);
+        if (index_->find(idx_, hashkey) == node)  // a colliding key may own the hashkey
+            index_->erase(idx_, hashkey);
+        topKValid_ = false;
+        pool_->release(node);
+        --nNodes_;
+    }
+
+    /**
+     * on-demand registration of a key seen at runtime (see DYSO_NODE_ON_DEMAND).
+     * If the row already has maxNodes nodes, the coldest node (tail of idx=-1) makes room,
+     * unless it is cached or being installed. Return NODE_NULL if no node can be evicted.
+     */
+    NodeHandle registerNode(const uint32_t& key, const uint32_t& hashkey, const uint32_t& maxNodes) {
+        NodeHandle node = index_->find(idx_, hashkey);
+        if (node != NODE_NULL)
+            return node;
+        if (nNodes_ >= maxNodes && !evictColdNode())
+            return NODE_NULL;
+        addDefaultNode(key, hashkey);
+        return backing_.getNodeList();  // just pushed at head of idx=-1
+    }
+
+    /* evict one node not counted in the last N_HEAD agings, from the tail of idx=-1 */
+    bool evictColdNode() {
+        NodePool& pool = *pool_;
+        NodeHandle first = backing_.getNodeList();
+        if (first == NODE_NULL)
+            return false;
+        // skip nodes cached or in the pending update (at most 2 * STAGE_CACHE)
+        NodeHandle h = pool[first].prev_;
+        for (uint32_t i = 0; i <= 2 * STAGE_CACHE; i++) {
+            const Node& node = pool[h];
+            if (!node.cache_ && std::find(cchUpdate_.begin(), cchUpdate_.end(), h) == cchUpdate_.end()) {
+                removeNode(h, crc32_sw_u32(node.key_) & REG_MASK_GET_HASHKEY);
+                return true;
+            }
+            if (h == first)
+                break;
+            h = node.prev_;
         }
-        delete node;
+        return false;
+    }
+
+    /* index of node's head (-1 if expired to backing head) */
+    int getHeadIdx(const Node& node) const {
+        return (node.headGen_ >= agingEpoch_) ? int(node.headGen_ - agingEpoch_) : -1;
+    }
+    uint32_t getHeadGen(const int& idx) const { return agingEpoch_ + idx; }
+
+    /* head of idx (-1 : backing) */
+    Head& getHead(const int& idx) {
+        if (idx < 0)
+            return backing_;
+        uint32_t slot = headBase_ + idx;
+        return heads_[(slot >= N_HEAD) ? slot - N_HEAD : slot];
+    }
+    const Head& getHead(const int& idx) const { return const_cast<Dyso*>(this)->getHead(idx); }
+
+    /* push/pop at head of idx, keeping the non-empty head bitmap */
+    void pushNodeToHead(const int& idx, const NodeHandle& h) {
+        getHead(idx).pushNode(*pool_, h);
+        if (idx >= 0)
+            nonEmpty_ |= (1u << idx);
+    }
+    void popNodeFromHead(const int& idx, const NodeHandle& h) {
+        Head& head = getHead(idx);
+        head.popNode(*pool_, h);
+        if (idx >= 0 && head.getNodeList() == NODE_NULL)
+            nonEmpty_ &= ~(1u << idx);
     }
 
     void doAging() {
         // (1) move nodes at idx=0 to idx=-1 (top: idx=0, bottom: idx=-1)
-        Node* nodeToTop = heads_[1]->getNodeList();
-        if (nodeToTop != nullptr) {
-            Node* nodeToBottom = heads_[0]->getNodeList();
-            Node* nodeToBottomTail = nodeToBottom->prev_;
-            nodeToTop->prev_->next_ = nodeToBottom;
-            nodeToBottom->prev_ = nodeToTop->prev_;
-            nodeToTop->prev_ = nodeToBottomTail;
-            heads_[0]->setNodeList(nodeToTop);
+        NodePool& pool = *pool_;
+        Head& headToAge = heads_[headBase_];
+        NodeHandle nodeToTop = headToAge.getNodeList();
+        if (nodeToTop != NODE_NULL && backing_.getNodeList() == NODE_NULL) {
+            // empty bottom (all nodes are counted) -> just move the list
+            backing_.setNodeList(nodeToTop);
+        } else if (nodeToTop != NODE_NULL) {
+            NodeHandle nodeToBottom = backing_.getNodeList();
+            NodeHandle nodeToBottomTail = pool[nodeToBottom].prev_;
+            pool[pool[nodeToTop].prev_].next_ = nodeToBottom;
+            pool[nodeToBottom].prev_ = pool[nodeToTop].prev_;
+            pool[nodeToTop].prev_ = nodeToBottomTail;
+            backing_.setNodeList(nodeToTop);
         }
 
-        // (2) reset idx=0 then pop it
-        heads_[1].reset();
-        heads_.erase(std::next(heads_.begin()));
+        // (2) the emptied slot becomes the new idx=N_HEAD-1, and its nodes are expired by the new epoch
+        headToAge.setNodeList(NODE_NULL);
+        headBase_ = (headBase_ + 1 == N_HEAD) ? 0 : headBase_ + 1;
+        nonEmpty_ >>= 1;
+        ++agingEpoch_;
 
-        // (3) aging headers
-        for (std::vector<std::shared_ptr<Head>>::iterator it = std::next(heads_.begin()); it != heads_.end(); ++it)
-            (*it)->aging();
+        if (agingEpoch_ >= HEAD_EPOCH_REBASE) {
+            rebaseEpoch();
+        }
+    }
 
-        // (4) push back a new head
-        heads_.emplace_back(std::make_shared<Head>(Head(N_HEAD - 1, 1.0 / (1 << (N_HEAD - 1)))));
+    /* reset the epoch and gens of all nodes before the epoch wraps around */
+    void rebaseEpoch() {
+        NodePool& pool = *pool_;
+        agingEpoch_ = HEAD_EPOCH_INIT;
+        for (int idx = -1; idx < N_HEAD; idx++) {
+            for (NodeHandle h = getHead(idx).getNodeList(); h != NODE_NULL; h = pool[h].next_) {
+                pool[h].headGen_ = (idx >= 0) ? getHeadGen(idx) : HEAD_GEN_BACKING;
+            }
+        }
+        topKValid_ = false;
     }
 
     /**
      * In fact, this "updating" step is not quite optimized, so can be enhanced with further efforts.
      */ 
-    void updateNode(Node* node, const uint32_t& count) {
-        // Count = 0 or Node* is not initialized, then skip
-        if (!node || count == 0) {
+    void updateNode(const NodeHandle& h, const uint32_t& count) {
+        // Count = 0 or Node is not initialized, then skip
+        if (h == NODE_NULL || count == 0) {
             return;
         }
+        Node& node = (*pool_)[h];
 
         // update total count
         totalCount_ = totalCount_ + count;
 
         // update and move if necessary
-        std::shared_ptr<Head> currPtr = node->wHead_.lock();
-        if (currPtr) {
+        int idx = getHeadIdx(node);
+        if (idx >= 0) {
             // idx >= 0
-            node->count_ = node->count_ + count * currPtr->getUnitAdd();
-            if (UNDERFLOW(node->count_)) {
-                currPtr->popThenPushNode(node);
-            } else if (node->wHead_.lock()->getIdx() == N_HEAD - 1) {
+            Head& curr = getHead(idx);
+            node.count_ = node.count_ + (count << GET_UNIT_SHIFT(idx));
+            if (UNDERFLOW(node.count_)) {
+                curr.popThenPushNode(*pool_, h);
+            } else if (idx == N_HEAD - 1) {
                 // last node with overflow -> just push to recency position
-                currPtr->popThenPushNode(node);
+                curr.popThenPushNode(*pool_, h);
             } else {
                 // remove links at old head
-                currPtr->popNode(node);
-                /* update pointer / counter -> push to Head */
-                uint32_t accumCount = (uint32_t)((1.0 + node->count_) * (1 << currPtr->getIdx()));
+                popNodeFromHead(idx, h);
+                /* update head / counter -> push to Head */
+                uint32_t accumCount = uint32_t((uint64_t(COUNT_ONE + node.count_) << idx) >> COUNT_FRAC_BIT);  // floor((1 + count) * 2^idx)
                 int idxHeadToMove = GET_HEAD_IDX(accumCount);
-                node->wHead_.reset();
-                node->wHead_ = heads_[idxHeadToMove + 1];
-                node->count_ = std::min((accumCount - (1 << idxHeadToMove)) * heads_[idxHeadToMove + 1]->getUnitAdd(), 1.0);
-                heads_[idxHeadToMove + 1]->pushNode(node);
+                node.headGen_ = getHeadGen(idxHeadToMove);
+                node.count_ = std::min((accumCount - (1 << idxHeadToMove)) << GET_UNIT_SHIFT(idxHeadToMove), COUNT_ONE);
+                pushNodeToHead(idxHeadToMove, h);
             }
         } else {
             // idx == -1, remove links at old head
-            heads_[0]->popNode(node);
-            /* update pointer / counter -> push to Head */
+            backing_.popNode(*pool_, h);
+            /* update head / counter -> push to Head */
             if (count == 1) {
                 /* simple case */
-                node->wHead_ = heads_[1];
-                node->count_ = 0.0;
-                heads_[1]->pushNode(node);
+                node.headGen_ = getHeadGen(0);
+                node.count_ = 0;
+                pushNodeToHead(0, h);
             } else {
                 /* jump case */
                 int idxHeadToMove = GET_HEAD_IDX(count);
-                node->wHead_ = heads_[idxHeadToMove + 1];
-                node->count_ = (count - (1 << idxHeadToMove)) * heads_[idxHeadToMove + 1]->getUnitAdd();
-                heads_[idxHeadToMove + 1]->pushNode(node);
+                node.headGen_ = getHeadGen(idxHeadToMove);
+                node.count_ = (count - (1 << idxHeadToMove)) << GET_UNIT_SHIFT(idxHeadToMove);
+                pushNodeToHead(idxHeadToMove, h);
             }
         }
+
+        // the node is pushed to the front of a head, at or above the last node of frontier -> frontier changes
+        if (node.headGen_ >= topKMinGen_)
+            topKValid_ = false;
+    }
+
+    /* re-collect the top-STAGE_CACHE frontier, skipping empty heads by the bitmap */
+    void refreshTopK() {
+        const NodePool& pool = *pool_;
+        uint32_t mask = nonEmpty_;
+        int idx = -1;
+        nTopK_ = 0;
+        topKUncached_ = 0;
+        auto collect = [&](const int& i) {
+            for (NodeHandle node = getHead(i).getNodeList(); node != NODE_NULL && nTopK_ < STAGE_CACHE; node = pool[node].next_) {
+                topKUncached_ += 1 - pool[node].cache_;
+                topK_[nTopK_++] = node;
+            }
+        };
+        while (mask != 0 && nTopK_ < STAGE_CACHE) {
+            idx = 31 - __builtin_clz(mask);  // highest non-empty head
+            collect(idx);
+            mask &= ~(1u << idx);
+        }
+        if (nTopK_ < STAGE_CACHE) {
+            idx = -1;  // then backing head (not in the bitmap)
+            collect(idx);
+        }
+
+        for (uint32_t i = nTopK_; i < STAGE_CACHE; i++)
+            topK_[i] = NODE_NULL;
+        topKMinGen_ = (nTopK_ == STAGE_CACHE && idx >= 0) ? getHeadGen(idx) : HEAD_GEN_BACKING;
+        topKValid_ = true;
     }
 
     /**
      * for main policy
+     * return true if the key was in cache (virtual hit) when the signature arrives
      **/
-    void updatePolicyStat(const uint32_t& hashKey, uint32_t count = 1) {
+    bool updatePolicyStat(const uint32_t& hashKey, uint32_t count = 1) {
         assert(hashKey < (1 << REG_LEN_HASHKEY_BIT));  // 26-bit hashKey
-        Node* node;
-
-        // get node from hashmap
-        try {
-            node = hashmap_.at(hashKey);
-        } catch (const std::out_of_range& oor) {
-            std::cerr << "[UpdateStat] Out of Range (updateMissRepoNode): " << oor.what() << "\n";
-            std::cerr << "Hashkey: " << hashKey << ", dysoIdx: " << this->idx_ << "\n";
-            exit(1);
+        NodeHandle node;
+
+        // get node from index (unknown hashkey, e.g., from keys not installed -> miss)
+        if ((node = index_->find(idx_, hashKey)) == NODE_NULL) {
+#if (DYSODEBUG >= 1)
+            printf("[UpdateStat] Unknown hashkey: %u, dysoIdx: %u\n", hashKey, this->idx_);
+#endif
+            ++unknownKey_;
+            return false;
         }
+        return updatePolicyStatNode(node, count);
+    }
 
+    /* with the node already looked up (e.g., registered on demand) */
+    bool updatePolicyStatNode(const NodeHandle& node, uint32_t count = 1) {
         // try aging
         if (totalCount_ >= agingPeriod_) {
             doAging();        // aging
@@ -346,89 +866,115 @@ class Dyso {
         }
 
         // update node
+        bool hit = (*pool_)[node].cache_;
         updateNode(node, count);
 
         // try to make decision, if small buffer and missed
-        if (!node->cache_ && replaceInProgress_ == false && updateQueue_->check_full() == false) {
+        if (!hit && replaceInProgress_ == false && updateQueue_->check_full() == false) {
             makeUpdateRequest();
         }
+        return hit;
     }
 
     void makeUpdateRequest() {
-        Node* node;
-        uint32_t out_of_order = 0;
-        std::vector<Node*> topK;
-        std::vector<std::shared_ptr<Head>>::reverse_iterator rit;
-        for (rit = heads_.rbegin(); rit != heads_.rend(); ++rit) {
-            node = (*rit)->getNodeList();
-            if (node == nullptr)
-                continue;
-
-            while (node != nullptr) {
-                out_of_order = out_of_order + (1 - node->cache_);
-                topK.push_back(node);
-                if (topK.size() == STAGE_CACHE)
-                    goto decision;
-                node = node->next_;
-            }
-        }
-        assert(false);
-
-    decision:
-        if (out_of_order > 0) {
-            /* push a request to the DPDK-Tx Queue
-             craft Update Packet header (keys are Bit-Endian (network)) */
-            pcpp::dysoCtrlhdr* fetched = nullptr;
-
-            /* insert to updateQueue_ */
-            if ((fetched = updateQueue_->alloc()) != nullptr) {
-                fetched->index_update = htonl(this->idx_);
-                fetched->key0 = topK[0]->key_;
-                fetched->key1 = topK[1]->key_;
-                fetched->key2 = topK[2]->key_;
-                fetched->key3 = topK[3]->key_;
-                updateQueue_->push();
-            } else {
-                // queue is full, so skip updating
-                // return;
+        if (!topKValid_)
+            refreshTopK();
 
-                std::cerr << "[ERROR] DySO's TxQueue violates SPSC Queue!!" << std::endl;
-                exit(1);
-            }
+        // top-K is already in cache -> no update (unless the data plane is to be resynchronized)
+        if (topKUncached_ == 0 && !resync_)
+            return;
 
-            /* change to status -> on-going state update */
-            cchUpdate_ = topK;
-            replaceInProgress_ = true;
+        /* push a request to the DPDK-Tx Queue */
+        updateSeq_ = (updateSeq_ + 1) & UPDATE_SEQ_MASK;
+        if (!pushUpdate(topK_)) {
+            std::cerr << "[ERROR] DySO's TxQueue violates SPSC Queue!!" << std::endl;
+            exit(1);
         }
+
+        /* change to status -> on-going state update */
+        cchUpdate_ = topK_;
+        replaceInProgress_ = true;
+        retransmitLeft_ = UPDATE_MAX_RETRANSMIT;
     }
 
-    void moveUpdateToActive() {
-        /**
-         * Just using "replaceInProgress_" may make this policy dead if no return of ACK (i.e., packet loss).
-         * Especially, when UPDATE is dropped and never come back.
-         * TODO: We may need to implement TIMEOUT module.
-         */
+    /**
+     * craft Update Packet header (keys are Big-Endian (network), empty entries if # nodes < STAGE_CACHE).
+     * index_update carries the sequence of the UPDATE above the row, which its ACK echoes (see moveUpdateToActive).
+     */
+    bool pushUpdate(const std::array<NodeHandle, STAGE_CACHE>& nodes) {
+        const NodePool& pool = *pool_;
+        pcpp::dysoCtrlhdr* fetched = nullptr;
+        if ((fetched = updateQueue_->alloc()) == nullptr)
+            return false;  // queue is full
+        updatePos_ = updateQueue_->getWriteIdx();
+        updateQueued_ = true;
+        fetched->index_update = htonl(this->idx_ | (updateSeq_ << UPDATE_SEQ_SHIFT));
+        fetched->key0 = (nodes[0] != NODE_NULL) ? pool[nodes[0]].key_ : htonl(DEFAULT_EMPTY_VALUE);
+        fetched->key1 = (nodes[1] != NODE_NULL) ? pool[nodes[1]].key_ : htonl(DEFAULT_EMPTY_VALUE);
+        fetched->key2 = (nodes[2] != NODE_NULL) ? pool[nodes[2]].key_ : htonl(DEFAULT_EMPTY_VALUE);
+        fetched->key3 = (nodes[3] != NODE_NULL) ? pool[nodes[3]].key_ : htonl(DEFAULT_EMPTY_VALUE);
+        updateQueue_->push();
+        return true;
+    }
 
-        /* triggered once Dyso's CP gets Update Packet */
-        if (cchUpdate_.empty() || replaceInProgress_ == false) {
-            printf("[*WARNING*] Dyso %u (Progress:%d) ---> Mysterious ACK, maybe from prior experiment?\n\n",
-                   this->idx_, replaceInProgress_);
-            exit(1);
+    /**
+     * called when the UPDATE in flight has no ACK until its deadline.
+     * If its last copy is still in updateQueue_, it is not lost (update core is behind), so it only waits.
+     * Otherwise the UPDATE or its ACK is lost, and the same UPDATE (same sequence and keys) is retransmitted.
+     * After UPDATE_MAX_RETRANSMIT, the UPDATE is rolled back : cchActive_ is kept, but the data plane may have
+     * applied cchUpdate_, so resync_ forces the next UPDATE (which rewrites all STAGE_CACHE keys of the row)
+     * even if the top-K is cached. A late ACK of the rolled-back UPDATE still confirms cchUpdate_ until then.
+     * Return true if it is still in flight (to be scheduled again).
+     */
+    bool onUpdateTimeout() {
+        assert(replaceInProgress_);
+        if (updateQueued_ && !updateQueue_->isPopped(updatePos_))
+            return true;
+        ++nTimeout_;
+        if (retransmitLeft_ > 0) {
+            if (pushUpdate(cchUpdate_)) {
+                --retransmitLeft_;
+                ++nRetransmit_;
+            }
+            return true;  // retry at the next deadline if the queue is full
+        }
+        ++nRollback_;
+        replaceInProgress_ = false;
+        resync_ = true;
+        topKValid_ = false;
+        return false;
+    }
+
+    /**
+     * triggered once Dyso's CP gets the ACK of sequence seq.
+     * Return true if it confirms the UPDATE in flight (false for a stale ACK, or a late ACK after rollback).
+     */
+    bool moveUpdateToActive(const uint32_t& seq) {
+        const bool inFlight = replaceInProgress_;
+        if (seq != updateSeq_ || (!replaceInProgress_ && !resync_)) {
+            // duplicated ACK of a retransmitted UPDATE, ACK of a superseded UPDATE, or ACK after restart
+#if (DYSODEBUG >= 1)
+            printf("[*WARNING*] Dyso %u ---> ACK of seq %u, not of the UPDATE in flight (ignored)\n", this->idx_, seq);
+#endif
+            ++nStaleAck_;
+            return false;
         }
 
         for (uint32_t i = 0; i < STAGE_CACHE; i++)
-            if (cchActive_[i])
-                cchActive_[i]->cache_ = 0;
+            if (cchActive_[i] != NODE_NULL)
+                (*pool_)[cchActive_[i]].cache_ = 0;
 
         for (uint32_t i = 0; i < STAGE_CACHE; i++)
-            if (cchUpdate_[i])
-                cchUpdate_[i]->cache_ = 1;
+            if (cchUpdate_[i] != NODE_NULL)
+                (*pool_)[cchUpdate_[i]].cache_ = 1;
 
-        // move states: Update --> Active
-        // cchUpdate_.resize(STAGE_CACHE);  // handle exception: # nodes < 4
+        // move states: Update --> Active (the data plane holds all keys of the row as recorded)
         cchActive_ = cchUpdate_;
-        cchUpdate_.clear();
+        cchUpdate_.fill(NODE_NULL);
         replaceInProgress_ = false;
+        resync_ = false;
+        topKValid_ = false;  // cache flags are changed
+        return inFlight;
     }
 
     /* for main policy */
@@ -438,16 +984,17 @@ class Dyso {
 
     // API: printAll
     void printAll() {
-        for (const auto& head : heads_) {
-            head->printAll();
+        const NodePool& pool = *pool_;
+        for (int idx = -1; idx < N_HEAD; idx++) {
+            getHead(idx).printAll(pool, idx);
         }
         for (const auto& node : cchActive_) {
-            if (node)
-                cPrint("Dyso-PrintAll", "[CacheActive] Key: %d, Count: %f", ntohl(node->key_), node->count_);
+            if (node != NODE_NULL)
+                cPrint("Dyso-PrintAll", "[CacheActive] Key: %d, Count: %f", ntohl(pool[node].key_), COUNT_TO_DOUBLE(pool[node].count_));
         }
         for (const auto& node : cchUpdate_) {
-            if (node)
-                cPrint("Dyso-PrintAll", "[CacheUpdate] Key: %d, Count: %f", ntohl(node->key_), node->count_);
+            if (node != NODE_NULL)
+                cPrint("Dyso-PrintAll", "[CacheUpdate] Key: %d, Count: %f", ntohl(pool[node].key_), COUNT_TO_DOUBLE(pool[node].count_));
         }
 
         cPrint("Dyso-PrintAll", "============ Finished Prining =============\n");
@@ -459,18 +1006,16 @@ class Dyso {
 
     void updatePolicyStatReplica(const uint32_t& hashKey, uint32_t& virtQLen, uint32_t count = 1) {
         assert(hashKey < (1 << REG_LEN_HASHKEY_BIT));  // 26-bit hashkey
-        Node* node;
-        // get node from hashmap
-        try {
-            node = hashmap_.at(hashKey);
-        } catch (const std::out_of_range& oor) {
-            std::cerr << "[UpdateStat-Replica] Out of Range (updateMissRepoNode): " << oor.what() << "\n";
-            std::cerr << "Hashkey: " << hashKey << ", dysoIdx: " << idx_ << "\n";
-            exit(1);
+        NodeHandle node;
+        // get node from index
+        if ((node = index_->find(idx_, hashKey)) == NODE_NULL) {
+            ++unknownKey_;
+            ++virtMiss_;
+            return;
         }
 
         // update hit/miss rate
-        auto hitOrMiss = node->cache_;
+        auto hitOrMiss = (*pool_)[node].cache_;
         (hitOrMiss == 1) ? ++(virtHit_) : ++(virtMiss_);
 
         // try aging
@@ -493,37 +1038,24 @@ class Dyso {
     /* for replica policy */
     bool makeUpdateReuqestReplica() {
         // pick top-(nCacheStage_) items
-        Node* node;
-        uint8_t out_of_order = 0;
-        std::vector<Node*> topK;
-        std::vector<std::shared_ptr<Head>>::reverse_iterator rit;
-        for (rit = heads_.rbegin(); rit != heads_.rend(); ++rit) {
-            node = (*rit)->getNodeList();
-            if (node == nullptr)
-                continue;
-
-            while (node != nullptr) {
-                out_of_order = out_of_order + (1 - node->cache_);
-                topK.emplace_back(node);
-                if (topK.size() == STAGE_CACHE)
-                    goto decision;
-                node = node->next_;
-            }
-        }
+        NodePool& pool = *pool_;
+        if (!topKValid_)
+            refreshTopK();
 
-    decision:
-        if (out_of_order > 0) {
+        if (topKUncached_ > 0) {
             // update cache flags
             for (auto& node : cchActive_) {
-                if (node)
-                    node->cache_ = false;
+                if (node != NODE_NULL)
+                    pool[node].cache_ = false;
             }
-            for (auto& node : topK) {
-                node->cache_ = true;
+            for (auto& node : topK_) {
+                if (node != NODE_NULL)
+                    pool[node].cache_ = true;
             }
 
-            // copy topK to cchActive_
-            cchActive_ = topK;
+            // copy topK to cchActive_ (frontier is all cached now)
+            cchActive_ = topK_;
+            topKUncached_ = 0;
             return true;
         }
         return false;
@@ -535,7 +1067,7 @@ class Dyso {
         this->virtMiss_ = 0;
 
         // sanity check
-        assert(this->cchUpdate_.empty());
+        assert(this->replaceInProgress_ == false);
         if (agingPeriod == 0) {
             std::invalid_argument("agingPeriod should be larger than 0...");
             exit(1);
@@ -546,16 +1078,154 @@ class Dyso {
 
         // clean cache information
         for (auto& node : this->cchActive_) {
-            if (node) {
-                node->cache_ = false;
+            if (node != NODE_NULL) {
+                (*pool_)[node].cache_ = false;
             }
         }
-        this->cchActive_.clear();
-        this->cchActive_.resize(STAGE_CACHE);
+        this->cchActive_.fill(NODE_NULL);
         // clean node information (all nodes will be at headIdx=-1)
         for (size_t i = 0; i < N_HEAD; i++) {
             doAging();
         }
+        this->topKValid_ = false;
+    }
+
+    /* release all nodes of this row (e.g., moved to another worker), keeping its parameters */
+    void releaseAllNodes() {
+        NodePool& pool = *pool_;
+        for (int idx = -1; idx < N_HEAD; idx++) {
+            Head& head = getHead(idx);
+            for (NodeHandle h = head.getNodeList(); h != NODE_NULL;) {
+                NodeHandle next = pool[h].next_;
+                uint32_t hashkey = crc32_sw_u32(pool[h].key_) & REG_MASK_GET_HASHKEY;
+                if (index_->find(idx_, hashkey) == h)  // a colliding key may own the hashkey
+                    index_->erase(idx_, hashkey);
+                pool.release(h);
+                h = next;
+            }
+            head.setNodeList(NODE_NULL);
+        }
+        nonEmpty_ = 0;
+        nNodes_ = 0;
+        totalCount_ = 0;
+        unknownKey_ = 0;  // moved with the row
+        cchActive_.fill(NODE_NULL);
+        cchUpdate_.fill(NODE_NULL);
+        replaceInProgress_ = false;
+        resync_ = false;
+        updateQueued_ = false;
+        topKValid_ = false;
+    }
+
+    /**
+     * write CheckpointRow and CheckpointNodes of this row, with writer.write(data, len).
+     * An UPDATE in progress is recorded, but only resumed by moving the row (it is rolled back after restore).
+     */
+    template <typename Writer>
+    void saveCheckpoint(Writer& writer) const {
+        const NodePool& pool = *pool_;
+        CheckpointRow row = {};
+        row.idx = idx_;
+        row.agingPeriod = agingPeriod_;
+        row.totalCount = totalCount_;
+        row.unknownKey = unknownKey_;
+        row.virtHit = virtHit_;
+        row.virtMiss = virtMiss_;
+        std::fill(std::begin(row.cchActive), std::end(row.cchActive), UINT32_MAX);
+        std::fill(std::begin(row.cchUpdate), std::end(row.cchUpdate), UINT32_MAX);
+        row.updateInProgress = replaceInProgress_ ? 1 : 0;
+        row.retransmitLeft = retransmitLeft_;
+        row.updateSeq = updateSeq_;
+        row.resync = resync_ ? 1 : 0;
+
+        // nodes of head idx, from tail to front
+        auto forEachNode = [&](const int& idx, auto&& func) {
+            NodeHandle first = getHead(idx).getNodeList();
+            if (first == NODE_NULL)
+                return;
+            for (NodeHandle h = pool[first].prev_;; h = pool[h].prev_) {
+                func(h);
+                if (h == first)
+                    break;
+            }
+        };
+
+        uint32_t ordinal = 0;
+        for (int idx = -1; idx < N_HEAD; idx++) {
+            forEachNode(idx, [&](const NodeHandle& h) {
+                for (uint32_t i = 0; i < STAGE_CACHE; i++) {
+                    row.cchActive[i] = (cchActive_[i] == h) ? ordinal : row.cchActive[i];
+                    row.cchUpdate[i] = (cchUpdate_[i] == h) ? ordinal : row.cchUpdate[i];
+                }
+                row.nNodes[idx + 1]++;
+                ordinal++;
+            });
+        }
+        writer.write(&row, sizeof(row));
+
+        for (int idx = -1; idx < N_HEAD; idx++) {
+            forEachNode(idx, [&](const NodeHandle& h) {
+                const Node& node = pool[h];
+                CheckpointNode rec = {};
+                rec.key = node.key_;
+                rec.hashkey = crc32_sw_u32(node.key_) & REG_MASK_GET_HASHKEY;
+                rec.count = node.count_;
+                rec.cache = node.cache_;
+                rec.indexed = (index_->find(idx_, rec.hashkey) == h) ? 1 : 0;
+                writer.write(&rec, sizeof(rec));
+            });
+        }
+    }
+
+    /**
+     * restore this row (with no nodes yet) from its checkpoint records, and its UPDATE in flight if resumeUpdate.
+     * Otherwise the UPDATE in flight is taken as rolled back, as the data plane may have applied it.
+     */
+    void loadCheckpoint(const CheckpointRow& row, const CheckpointNode* nodes, const bool& resumeUpdate = false) {
+        assert(nNodes_ == 0 && row.idx == idx_);
+        agingPeriod_ = row.agingPeriod;
+        totalCount_ = row.totalCount;
+        unknownKey_ = row.unknownKey;
+        virtHit_ = row.virtHit;
+        virtMiss_ = row.virtMiss;
+        agingEpoch_ = HEAD_EPOCH_INIT;
+        headBase_ = 0;
+
+        uint32_t nRecords = 0;
+        for (int idx = -1; idx < N_HEAD; idx++)
+            nRecords += row.nNodes[idx + 1];
+
+        cchActive_.fill(NODE_NULL);
+        cchUpdate_.fill(NODE_NULL);
+        uint32_t ordinal = 0;
+        for (int idx = -1; idx < N_HEAD; idx++) {
+            for (uint32_t i = 0; i < row.nNodes[idx + 1]; i++, ordinal++) {
+                const CheckpointNode& rec = nodes[ordinal];
+                if (ordinal + 16 < nRecords)
+                    index_->prefetch(idx_, nodes[ordinal + 16].hashkey);
+                NodeHandle h = pool_->alloc(rec.key);
+                Node& node = (*pool_)[h];
+                node.count_ = rec.count;
+                node.cache_ = rec.cache;
+                node.headGen_ = (idx >= 0) ? getHeadGen(idx) : HEAD_GEN_BACKING;
+                pushNodeToHead(idx, h);
+                if (rec.indexed)
+                    index_->insert(idx_, rec.hashkey, h);
+                ++nNodes_;
+                for (uint32_t j = 0; j < STAGE_CACHE; j++) {
+                    cchActive_[j] = (row.cchActive[j] == ordinal) ? h : cchActive_[j];
+                    cchUpdate_[j] = (row.cchUpdate[j] == ordinal) ? h : cchUpdate_[j];
+                }
+            }
+        }
+        replaceInProgress_ = resumeUpdate && row.updateInProgress != 0;
+        resync_ = row.resync != 0 || (!resumeUpdate && row.updateInProgress != 0);
+        retransmitLeft_ = row.retransmitLeft;
+        updateSeq_ = row.updateSeq & UPDATE_SEQ_MASK;
+        updateQueued_ = false;  // copies are in the queue of the old worker, if any
+        if (!replaceInProgress_ && !resync_)
+            cchUpdate_.fill(NODE_NULL);
+        topKValid_ = false;
     }
 
     /* for replica policy */
@@ -563,4 +1233,12 @@ class Dyso {
     double getMissRate() const { return double(virtMiss_) / (virtHit_ + virtMiss_); }
     void getAgingPeriod(uint32_t& agingPeriod) const { agingPeriod = this->agingPeriod_; }
     uint32_t getDysoIdx() const { return idx_; }
+    uint64_t getUnknownKey() const { return unknownKey_; }
+    bool isUpdateInProgress() const { return replaceInProgress_; }
+    uint64_t getTimeout() const { return nTimeout_; }
+    uint64_t getRetransmit() const { return nRetransmit_; }
+    uint64_t getRollback() const { return nRollback_; }
+    uint64_t getStaleAck() const { return nStaleAck_; }
+    uint32_t getNumNodes() const { return nNodes_; }
+    NodeHandle findNode(const uint32_t& hashKey) const { return index_->find(idx_, hashKey); }
 };
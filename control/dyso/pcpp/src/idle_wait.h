@@ -0,0 +1,97 @@
+#pragma once
+
+#include <linux/futex.h>
+#include <stdint.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+
+/* spin-wait hint (pause : yields the pipeline to the sibling hyper-thread, and saves power) */
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+/**
+ * Doorbell of a consumer polling SPSC queues, to park it when they are empty (in shared memory, or process memory).
+ * The consumer announces that it is parking, checks the queues again, then sleeps on a futex (with timeout).
+ * Producers ring it after pushing, which costs a fence and a load while the consumer is running,
+ * and a futex wake only if it is parked. Zero-filled memory is a valid doorbell.
+ */
+struct Doorbell {
+    alignas(128) std::atomic<uint32_t> seq;  // bumped by producers to wake the consumer
+    std::atomic<uint32_t> parked;            // 1 while the consumer is (about to be) parked
+    std::atomic<uint64_t> nWakeup;           // futex wakes by producers
+
+    /* For producer : after pushing to a queue of the consumer */
+    void ring() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);  // push before reading parked (pairs with park)
+        if (parked.load(std::memory_order_relaxed) == 0)
+            return;
+        seq.fetch_add(1, std::memory_order_release);
+        syscall(SYS_futex, (uint32_t*)&seq, FUTEX_WAKE, 1, nullptr, nullptr, 0);
+        nWakeup.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /* For consumer : sleep up to timeoutUs unless isEmpty() turns false, return false if not parked */
+    template <typename F>
+    bool park(F&& isEmpty, const uint32_t& timeoutUs) {
+        parked.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);  // parked before reading queues (pairs with ring)
+        uint32_t s = seq.load(std::memory_order_acquire);
+        bool parking = isEmpty();
+        if (parking) {
+            struct timespec timeout = {time_t(timeoutUs / 1000000), long(timeoutUs % 1000000) * 1000};
+            syscall(SYS_futex, (uint32_t*)&seq, FUTEX_WAIT, s, &timeout, nullptr, 0);  // returns at once if rung since
+        }
+        parked.store(0, std::memory_order_relaxed);
+        return parking;
+    }
+};
+
+/**
+ * Adaptive idle policy of a polling loop : spin for spinPolls empty polls, then pause for pausePolls
+ * (doubling the pauses per poll up to maxPause), then park (by the caller). Any work resets it to spinning,
+ * so the loop under load behaves as a busy-poll.
+ */
+class IdleBackoff {
+   private:
+    const uint32_t spinPolls_;
+    const uint32_t pausePolls_;
+    const uint32_t maxPause_;
+    uint32_t nEmpty_ = 0;
+    uint32_t nPause_ = 1;
+    uint64_t nPark_ = 0;
+
+   public:
+    IdleBackoff(const uint32_t& spinPolls, const uint32_t& pausePolls, const uint32_t& maxPause)
+        : spinPolls_(spinPolls), pausePolls_(pausePolls), maxPause_(maxPause) {}
+    ~IdleBackoff() {}
+
+    void reset() {
+        nEmpty_ = 0;
+        nPause_ = 1;
+    }
+
+    /* after an empty poll, return true if the caller should park now */
+    bool idle() {
+        if (++nEmpty_ <= spinPolls_)
+            return false;
+        if (nEmpty_ <= spinPolls_ + pausePolls_) {
+            for (uint32_t i = 0; i < nPause_; i++)
+                cpuRelax();
+            nPause_ = (nPause_ < maxPause_) ? nPause_ * 2 : maxPause_;
+            return false;
+        }
+        nPark_++;
+        return true;  // stays in this tier until reset
+    }
+
+    /* Accessor */
+    uint64_t getNumPark() const { return nPark_; }
+};
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+/**
+ * Minimal perfect hash over a static set of 64-bit keys (hash-and-displace, CHD/PTHash-style).
+ *
+ * Keys are split into buckets of ~MPHF_BUCKET_LOAD keys. From the largest bucket, each bucket searches
+ * a 16-bit pilot which places all its keys at free positions of a table of size m = n / MPHF_ALPHA.
+ * Positions in [n, m) are remapped to the free positions in [0, n), so lookup() is a bijection from the key set
+ * to [0, n) with ~3.5 bits per key (pilots + remap).
+ * For a key out of the set, lookup() returns an arbitrary position in [0, n), so the caller must verify the key.
+ */
+constexpr uint64_t MPHF_BUCKET_LOAD = 5;   // average number of keys per bucket
+constexpr uint64_t MPHF_ALPHA_PCT = 98;    // load factor of the table before remap (%)
+constexpr uint32_t MPHF_MAX_TRIAL = 16;    // number of seeds to try
+
+class PerfectHash {
+   private:
+    uint64_t seedHash_ = 0;
+    uint64_t n_ = 0;        // number of keys
+    uint64_t m_ = 0;        // size of table (>= n_)
+    uint64_t nBucket_ = 0;  // number of buckets
+    std::vector<uint16_t> pilots_;
+    std::vector<uint32_t> remap_;  // position in [n_, m_) -> free position in [0, n_)
+
+    /* splitmix64 finalizer */
+    static uint64_t mix(uint64_t x) {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ull;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebull;
+        x ^= x >> 31;
+        return x;
+    }
+    /* uniform map of 64-bit hash to [0, n) */
+    static uint64_t fastrange(const uint64_t& h, const uint64_t& n) {
+        return uint64_t(((unsigned __int128)h * n) >> 64);
+    }
+    static uint64_t pilotHash(const uint16_t& pilot) { return mix(pilot + 0x9E3779B97F4A7C15ull); }
+
+    uint64_t position(const uint64_t& keyHash, const uint16_t& pilot) const {
+        return fastrange((keyHash ^ pilotHash(pilot)) * 0x9E3779B97F4A7C15ull, m_);  // keys of a bucket share high bits
+    }
+
+   public:
+    PerfectHash() {}
+    ~PerfectHash() {}
+
+    /* keys must be distinct, return false if no pilot is found with MPHF_MAX_TRIAL seeds */
+    bool build(const std::vector<uint64_t>& keys, const uint64_t& seed = 1) {
+        n_ = keys.size();
+        m_ = (n_ * 100 + MPHF_ALPHA_PCT - 1) / MPHF_ALPHA_PCT;
+        nBucket_ = std::max((n_ + MPHF_BUCKET_LOAD - 1) / MPHF_BUCKET_LOAD, uint64_t(1));
+        pilots_.assign(nBucket_, 0);
+        remap_.clear();
+        if (n_ == 0)
+            return true;
+
+        std::vector<uint64_t> hashes(n_);
+        std::vector<uint32_t> bucketOffset(nBucket_ + 1);
+        std::vector<uint32_t> bucketOrder(nBucket_);
+        std::vector<uint64_t> taken((m_ + 63) / 64);
+        std::vector<uint64_t> pos;
+
+        for (uint32_t trial = 0; trial < MPHF_MAX_TRIAL; trial++) {
+            seedHash_ = mix(seed + trial);
+
+            // (1) group hashes of keys by buckets (counting sort)
+            std::fill(bucketOffset.begin(), bucketOffset.end(), 0);
+            for (const auto& key : keys)
+                bucketOffset[fastrange(mix(key ^ seedHash_), nBucket_) + 1]++;
+            uint32_t maxBucketSize = 0;
+            for (uint64_t b = 0; b < nBucket_; b++) {
+                maxBucketSize = std::max(maxBucketSize, bucketOffset[b + 1]);
+                bucketOffset[b + 1] += bucketOffset[b];
+            }
+            std::vector<uint32_t> cursor(bucketOffset.begin(), bucketOffset.end() - 1);
+            for (const auto& key : keys) {
+                uint64_t keyHash = mix(key ^ seedHash_);
+                hashes[cursor[fastrange(keyHash, nBucket_)]++] = keyHash;
+            }
+
+            // (2) order buckets by size, larger first (counting sort)
+            std::vector<uint32_t> sizeOffset(maxBucketSize + 2, 0);
+            for (uint64_t b = 0; b < nBucket_; b++)
+                sizeOffset[maxBucketSize - (bucketOffset[b + 1] - bucketOffset[b]) + 1]++;
+            for (uint32_t s = 0; s <= maxBucketSize; s++)
+                sizeOffset[s + 1] += sizeOffset[s];
+            for (uint64_t b = 0; b < nBucket_; b++)
+                bucketOrder[sizeOffset[maxBucketSize - (bucketOffset[b + 1] - bucketOffset[b])]++] = uint32_t(b);
+
+            // (3) search pilots
+            std::fill(taken.begin(), taken.end(), 0);
+            bool success = true;
+            for (const auto& b : bucketOrder) {
+                uint32_t begin = bucketOffset[b], end = bucketOffset[b + 1];
+                if (begin == end)
+                    break;  // the rest are empty buckets
+
+                bool placed = false;
+                for (uint32_t pilot = 0; pilot <= UINT16_MAX && !placed; pilot++) {
+                    pos.clear();
+                    placed = true;
+                    for (uint32_t i = begin; i < end && placed; i++) {
+                        uint64_t p = position(hashes[i], uint16_t(pilot));
+                        placed = ((taken[p >> 6] >> (p & 63)) & 1) == 0 && std::find(pos.begin(), pos.end(), p) == pos.end();
+                        pos.push_back(p);
+                    }
+                    if (placed) {
+                        pilots_[b] = uint16_t(pilot);
+                        for (const auto& p : pos)
+                            taken[p >> 6] |= (uint64_t(1) << (p & 63));
+                    }
+                }
+                if (!placed) {
+                    success = false;
+                    break;
+                }
+            }
+            if (!success)
+                continue;
+
+            // (4) remap taken positions in [n, m) to free positions in [0, n)
+            remap_.assign(m_ - n_, 0);
+            uint64_t freePos = 0;
+            for (uint64_t p = n_; p < m_; p++) {
+                if (((taken[p >> 6] >> (p & 63)) & 1) == 0)
+                    continue;
+                while ((taken[freePos >> 6] >> (freePos & 63)) & 1)
+                    freePos++;
+                remap_[p - n_] = uint32_t(freePos++);
+            }
+            return true;
+        }
+        return false;
+    }
+
+    /* position of key in [0, n) */
+    uint64_t lookup(const uint64_t& key) const {
+        uint64_t keyHash = mix(key ^ seedHash_);
+        uint64_t p = position(keyHash, pilots_[fastrange(keyHash, nBucket_)]);
+        return (p < n_) ? p : remap_[p - n_];
+    }
+
+    /* Accessor */
+    uint64_t size() const { return n_; }
+    uint64_t sizeInBits() const { return pilots_.size() * 16 + remap_.size() * 32; }
+};
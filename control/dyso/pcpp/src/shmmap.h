@@ -1,3 +1,5 @@
+#pragma once
+
 #include <bits/stdc++.h>
 #include <sys/shm.h>
 #include <sys/stat.h>
@@ -25,3 +27,69 @@ T* spsc_shmmap(const char * filename) {
     }
     return ret;
 }
+
+/**
+ * Anonymous memory of n objects (zero-filled), rounded up to 2MB and advised to be backed by transparent huge pages.
+ * We do not use MAP_HUGETLB on purpose, as the reserved huge pages are for DPDK (pcpp_dyso) on the same server.
+ */
+constexpr size_t HUGEPAGE_SIZE = (1 << 21);  // 2MB
+
+template<class T>
+T* hugepage_mmap(const size_t& n) {
+    size_t len = ((sizeof(T) * n + HUGEPAGE_SIZE - 1) / HUGEPAGE_SIZE) * HUGEPAGE_SIZE;
+    T* ret = (T*)mmap(0, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(ret == MAP_FAILED) {
+        std::cerr << "mmap failed: " << strerror(errno) << std::endl;
+        return nullptr;
+    }
+    madvise(ret, len, MADV_HUGEPAGE);  // best effort (e.g., THP is disabled)
+    return ret;
+}
+
+template<class T>
+void hugepage_munmap(T* addr, const size_t& n) {
+    size_t len = ((sizeof(T) * n + HUGEPAGE_SIZE - 1) / HUGEPAGE_SIZE) * HUGEPAGE_SIZE;
+    munmap(addr, len);
+}
+
+/* create (or truncate) a shared memory segment of len bytes, writable */
+inline void* shm_create(const char * filename, const size_t& len) {
+    int shm_fd = shm_open(filename, O_CREAT | O_RDWR | O_TRUNC, 0666);
+    if(shm_fd == -1) {
+        std::cerr << "shm_open failed: " << strerror(errno) << std::endl;
+        return nullptr;
+    }
+    if(ftruncate(shm_fd, len)) {
+        std::cerr << "ftruncate failed: " << strerror(errno) << std::endl;
+        close(shm_fd);
+        return nullptr;
+    }
+    void* ret = mmap(0, len, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+    close(shm_fd);
+    if(ret == MAP_FAILED) {
+        std::cerr << "mmap failed: " << strerror(errno) << std::endl;
+        return nullptr;
+    }
+    return ret;
+}
+
+/* attach an existing shared memory segment, read-only (len is set to its size), nullptr if not exist */
+inline const void* shm_attach(const char * filename, size_t& len) {
+    int shm_fd = shm_open(filename, O_RDONLY, 0666);
+    if(shm_fd == -1) {
+        return nullptr;
+    }
+    struct stat st;
+    if(fstat(shm_fd, &st) || st.st_size == 0) {
+        close(shm_fd);
+        return nullptr;
+    }
+    len = st.st_size;
+    void* ret = mmap(0, len, PROT_READ, MAP_SHARED, shm_fd, 0);
+    close(shm_fd);
+    if(ret == MAP_FAILED) {
+        std::cerr << "mmap failed: " << strerror(errno) << std::endl;
+        return nullptr;
+    }
+    return ret;
+}
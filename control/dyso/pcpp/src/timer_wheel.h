@@ -0,0 +1,50 @@
+#pragma once
+
+#include <assert.h>
+#include <stdint.h>
+
+#include <array>
+#include <vector>
+
+/**
+ * Single-level hashed timer wheel of 32-bit ids (e.g., rows with an UPDATE in flight).
+ * Time is given in ticks by the owner (advance), schedule() is O(1), and each tick visits one slot.
+ * Cancellation is lazy : an expired id is reported with its deadline, and the owner checks
+ * whether the id is still waiting for that deadline (e.g., ACK has arrived, or it was re-scheduled).
+ */
+template <uint32_t N_SLOT>
+class TimerWheel {
+    static_assert((N_SLOT & (N_SLOT - 1)) == 0, "number of slots must be power of two");
+
+   private:
+    std::array<std::vector<uint32_t>, N_SLOT> slots_;
+    uint64_t now_ = 0;
+    uint64_t size_ = 0;
+
+   public:
+    TimerWheel() {}
+    ~TimerWheel() {}
+
+    /* deadline of id after delay ticks, 0 < delay < N_SLOT */
+    uint64_t schedule(const uint32_t& id, const uint32_t& delay) {
+        assert(delay > 0 && delay < N_SLOT);
+        uint64_t deadline = now_ + delay;
+        slots_[deadline & (N_SLOT - 1)].push_back(id);
+        size_++;
+        return deadline;
+    }
+
+    /* next tick, calling onExpire(id, deadline) for ids scheduled at this tick (it may schedule again) */
+    template <typename F>
+    void advance(F&& onExpire) {
+        std::vector<uint32_t>& slot = slots_[++now_ & (N_SLOT - 1)];
+        size_ -= slot.size();
+        for (size_t i = 0; i < slot.size(); i++)
+            onExpire(slot[i], now_);  // never schedules to this slot (delay < N_SLOT)
+        slot.clear();
+    }
+
+    /* Accessor */
+    uint64_t now() const { return now_; }
+    uint64_t size() const { return size_; }
+};
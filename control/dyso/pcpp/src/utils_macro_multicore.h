@@ -2,17 +2,59 @@
 
 #include <stdint.h>
 
+#include <algorithm>
 #include <chrono>
+#include <map>
+#include <mutex>
 #include <string>
 
 /* for inter-process communications */
 #include "SPSCQueue.h"
+#include "idle_wait.h"
 #include "shmmap.h"
 #include "utils_header.h"
 
 /* debugging flag */
 #define DYSODEBUG (0) // 2: debugging, 1: warn, 0: info
 
+/* index of pre-installed nodes */
+#define DYSO_NODE_MPHF (0) // 1: minimal perfect hash over pre-installed keys (less memory), 0: open addressing only
+
+/* on-demand registration of keys (instead of pre-installing all keys) */
+#define DYSO_NODE_ON_DEMAND (0) // 1: register a key once it is seen ON_DEMAND_ADMIT_COUNT times, 0: pre-install all keys
+constexpr uint32_t ON_DEMAND_MAX_NODE_PER_ROW = 256;  // nodes per row, the coldest is evicted beyond
+constexpr uint32_t ON_DEMAND_ADMIT_COUNT = 2;         // signatures of an unknown key to be registered
+constexpr uint32_t ON_DEMAND_FILTER_RESET = 1024;     // signatures of a row to halve its admission counters
+
+/* timeout of UPDATEs in flight, in ticks of messages processed by a worker (see DysoWorker::expireUpdates) */
+constexpr uint32_t UPDATE_TIMEOUT_TICK = 1024;  // messages per tick
+constexpr uint32_t UPDATE_TIMEOUT = 16;         // ticks until an UPDATE without ACK expires (< 64)
+constexpr uint32_t UPDATE_MAX_RETRANSMIT = 2;   // retransmissions before rollback
+
+/* checkpoint of policy state for a warm restart (see "Checkpoint_multicore.h") */
+#define DYSO_CHECKPOINT_PERIOD_SEC (0) // seconds between background checkpoints (forks the worker), 0: disabled
+
+/* load-aware migration of rows between DySO workers (see Rebalancer_multicore.h) */
+#define DYSO_REBALANCE_PERIOD_SEC (0) // seconds between rebalancing by pcpp_dyso.o, 0: disabled (rows stay as dysoRowMap)
+constexpr double REBALANCE_THRESHOLD = 1.25;      // rebalance if the busiest worker has more than this times the mean load
+constexpr uint32_t REBALANCE_MAX_ROW = 8;         // rows to move per period
+constexpr uint32_t REBALANCE_COOLDOWN = 10;       // periods until a moved row may move again
+constexpr uint64_t REBALANCE_MIN_LOAD = 100000;   // signatures per period (of all workers) to consider rebalancing
+#if (DYSO_REBALANCE_PERIOD_SEC > 0) && (DYSO_CHECKPOINT_PERIOD_SEC > 0)
+#error "checkpoints record the rows of dysoRowMap only, rows moved by rebalancing would be lost at restore"
+#endif
+
+/* idle polling loops (see "idle_wait.h") : spin, then pause, then park */
+#define DYSO_IDLE_PARK (1) // 1: park idle loops (DySO workers until new msgs, DPDK cores for a while), 0: busy-poll only
+constexpr uint32_t IDLE_SPIN_POLLS = 256;    // empty polls spinning
+constexpr uint32_t IDLE_PAUSE_POLLS = 256;   // empty polls with pause (doubled per poll up to IDLE_MAX_PAUSE), then park
+constexpr uint32_t IDLE_MAX_PAUSE = 32;
+constexpr uint32_t IDLE_PARK_US = 10000;     // longest park of a DySO worker (woken by stat cores on new msgs)
+constexpr uint32_t IDLE_NIC_SLEEP_US = 20;   // park of a DPDK core (polling the NIC, no wakeup)
+
+/* telemetry pages of workers in shared memory (see "Telemetry_multicore.h", read by dyso_telemetry.o) */
+#define DYSO_TELEMETRY_PERIOD_US (1000) // microseconds between publishes by a worker, 0: disabled
+
 /* Stage Allocation from P4*/
 constexpr uint32_t STAGE_CACHE = 4;                                    // number of match-units
 constexpr uint32_t STAGE_RECORD = 8;                                   // number of stages for packet fingerprints
@@ -22,17 +64,103 @@ constexpr uint32_t REG_LEN_HASHKEY_BIT = 26;                           // In 32b
 constexpr uint32_t REG_LEN_DYSO_IDX_BIT = (32 - REG_LEN_HASHKEY_BIT);  // In 32bit fingerprint, the upper 6 bits is a lower 6 bits of dyso index
 constexpr uint32_t REG_MASK_GET_HASHKEY = 0x3FFFFFF;                   // lower 26 bits
 constexpr uint32_t REG_MASK_GET_DYSO_IDX = 0x3FFF;                     // lower 14 bits of crc32_mpeg
+constexpr uint32_t DEFAULT_EMPTY_VALUE = 7777777;                      // default/empty register value (key, index_update)
 
 /* Pcap++ & DPDK Engine Configuration */
-constexpr uint32_t nCoreForStat = 1;                                                  // (DPDK) 1 core for 1 thread
-constexpr uint32_t nCoreForUpdate = 1;                                                // (DPDK) 1 core for 1 thread
+constexpr uint32_t nCoreForStat = 1;                                                  // (DPDK) 1 core for 1 thread, 1 SPSCRxQueue per DySO worker (stat core 0 polls the only RX queue)
+constexpr uint32_t nCoreForUpdate = 1;                                                // (DPDK) 1 core for 1 thread, 1 RX/TX queue pair (each drains all SPSCTxQueues)
 constexpr uint32_t maskCoreToUse = ((1 << (1 + nCoreForStat + nCoreForUpdate)) - 1);  // 7 = b'111, using cores 0,1,2
+static_assert(nCoreForStat >= 1 && nCoreForUpdate >= 1, "at least one stat core and one update core");
 constexpr uint64_t MSG_MASK_UPDATE_FLAG = 0x8000000000000000;                         // (1000..)(00..00)
+constexpr uint64_t MSG_MASK_CTRL_FLAG = 0x4000000000000000;                           // (0100..)(00..00), see createCtrlMsg
 constexpr uint64_t MSG_MASK_GET_IDX = 0xFFFFFFFF00000000;                             // upper 32 bits
 constexpr uint64_t MSG_MASK_GET_KEY = 0xFFFFFFFF;                                     // lower 32 bits
+constexpr uint16_t ETHERTYPE_CTRL = 0xDEAD;                                           // ether type of control packets (see constants.p4)
+constexpr uint32_t ETH_HDR_LEN = 14;                                                  // control header follows untagged Ethernet header
+
+/**
+ * Sequence number of the UPDATEs of a row, in the bits of index_update above the row (see Dyso::pushUpdate).
+ * The data plane uses only the row bits as index and returns the header as is, so each ACK echoes the sequence
+ * of the UPDATE it confirms. index_update stays below DEFAULT_EMPTY_VALUE (empty-update).
+ */
+constexpr uint32_t UPDATE_SEQ_SHIFT = 14;  // log2(REG_LEN_KEY)
+constexpr uint32_t UPDATE_SEQ_MASK = 0xFF;
+static_assert((1u << UPDATE_SEQ_SHIFT) == REG_LEN_KEY, "sequence of UPDATEs must be above the row bits");
+static_assert(((UPDATE_SEQ_MASK << UPDATE_SEQ_SHIFT) | (REG_LEN_KEY - 1)) < DEFAULT_EMPTY_VALUE, "index_update must not look empty");
+inline uint32_t getAckSeq(const uint64_t& msg) { return uint32_t(msg >> (32 + UPDATE_SEQ_SHIFT)) & UPDATE_SEQ_MASK; }
 
-/* Number of DySo's multicore */
-constexpr uint32_t NUM_DYSO_WORKER = 4;  // number of dyso's core
+/* Number of DySO's multicore (set at startup, see setRowMap) */
+constexpr uint32_t DEFAULT_NUM_DYSO_WORKER = 4;  // default number of dyso's core
+constexpr uint32_t MAX_DYSO_WORKER = 64;         // upper bound of number of dyso's core
+constexpr uint32_t N_REPLICA_ROW = 16;           // rows of a dyso's core having up/down replicas (self-tuning)
+
+/**
+ * Row -> DySO worker assignment, set once at startup before any queue or worker is created (setRowMap),
+ * and identically in every process (pcpp_dyso.o, dyso_multicore.o) since stat cores demultiplex by it.
+ * A worker keeps the rows assigned to it in a dense table (local row id : rank among its rows),
+ * and replicas of its first N_REPLICA_ROW rows.
+ *  -- ROW_MAP_MODULO : row % nWorker (default, with 4 workers : row[1:0], local row id row[13:2])
+ *  -- ROW_MAP_BLOCK  : contiguous blocks of rows
+ */
+enum RowMapPartition : uint32_t {
+    ROW_MAP_MODULO = 0,
+    ROW_MAP_BLOCK = 1,
+};
+
+class RowMap {
+    static_assert((REG_LEN_KEY & (REG_LEN_KEY - 1)) == 0, "number of rows must be power of two");
+
+   private:
+    uint32_t nWorker_ = 0;
+    uint32_t partition_ = ROW_MAP_MODULO;
+    uint8_t worker_[REG_LEN_KEY];
+    uint16_t localRow_[REG_LEN_KEY];
+    uint32_t nRows_[MAX_DYSO_WORKER];
+
+   public:
+    RowMap() { init(DEFAULT_NUM_DYSO_WORKER, ROW_MAP_MODULO); }
+    ~RowMap() {}
+
+    /* return false if nWorker or partition is not valid */
+    bool init(const uint32_t& nWorker, const uint32_t& partition) {
+        if (nWorker == 0 || nWorker > MAX_DYSO_WORKER || (partition != ROW_MAP_MODULO && partition != ROW_MAP_BLOCK))
+            return false;
+        nWorker_ = nWorker;
+        partition_ = partition;
+        std::fill(nRows_, nRows_ + MAX_DYSO_WORKER, 0);
+        for (uint32_t row = 0; row < REG_LEN_KEY; row++) {
+            uint32_t worker = (partition_ == ROW_MAP_MODULO) ? row % nWorker_ : uint32_t(uint64_t(row) * nWorker_ / REG_LEN_KEY);
+            worker_[row] = uint8_t(worker);
+            localRow_[row] = uint16_t(nRows_[worker]++);
+        }
+        return true;
+    }
+
+    /* Accessor (row is masked, as it may come from a corrupted packet) */
+    uint32_t getWorker(const uint32_t& row) const { return worker_[row & (REG_LEN_KEY - 1)]; }
+    uint32_t getLocalRow(const uint32_t& row) const { return localRow_[row & (REG_LEN_KEY - 1)]; }
+    uint32_t getNumRows(const uint32_t& worker) const { return nRows_[worker]; }
+    uint32_t getNumWorker() const { return nWorker_; }
+    uint32_t getPartition() const { return partition_; }
+};
+inline RowMap dysoRowMap;
+
+/* "mod" or "block" (or its number), return false if unknown */
+inline bool parseRowMapPartition(const std::string& name, uint32_t& partition) {
+    if (name == "mod" || name == "0")
+        partition = ROW_MAP_MODULO;
+    else if (name == "block" || name == "1")
+        partition = ROW_MAP_BLOCK;
+    else
+        return false;
+    return true;
+}
+inline bool setRowMap(const uint32_t& nWorker, const uint32_t& partition) {
+    return dysoRowMap.init(nWorker, partition);
+}
+inline uint32_t getNumDysoWorker() {
+    return dysoRowMap.getNumWorker();
+}
 
 /**
  * Inline functions
@@ -48,20 +176,45 @@ inline void parseMsgAtStatThread(const uint64_t& msg, uint32_t& dysoIdx, uint32_
     hashkey = uint32_t(msg & MSG_MASK_GET_KEY);
 }
 
+/**
+ * control msgs from stat threads to DySO workers (not from the data plane) :
+ * MSG_MASK_CTRL_FLAG | (op << 48) | (dysoIdx << 32) | arg
+ *  -- MSG_CTRL_MIGRATE_OUT : the stat thread sends no more msgs of dysoIdx to this worker, arg is the new worker
+ *  -- MSG_CTRL_MIGRATE_IN  : the stat thread sends msgs of dysoIdx to this worker from now on, arg is the old worker
+ */
+enum CtrlMsgOp : uint32_t {
+    MSG_CTRL_MIGRATE_OUT = 1,
+    MSG_CTRL_MIGRATE_IN = 2,
+};
+inline uint64_t createCtrlMsg(const uint32_t& op, const uint32_t& dysoIdx, const uint32_t& arg) {
+    return MSG_MASK_CTRL_FLAG | (uint64_t(op & 0xFF) << 48) | (uint64_t(dysoIdx & 0xFFFF) << 32) | arg;
+}
+inline void parseCtrlMsg(const uint64_t& msg, uint32_t& op, uint32_t& dysoIdx, uint32_t& arg) {
+    op = uint32_t(msg >> 48) & 0xFF;
+    dysoIdx = uint32_t(msg >> 32) & 0xFFFF;
+    arg = uint32_t(msg & MSG_MASK_GET_KEY);
+}
+
 /* get dyso's index (lower 14 bits of crc32_mpeg) */
 inline uint32_t getDysoIdx(const uint32_t& crc32_mpeg) {
     return crc32_mpeg & REG_MASK_GET_DYSO_IDX;  // return lower 14 bits
 }
 
-/* dyso's replica and thread index. dysoIdx must be 14bits */
+/* dyso's replica and thread index (by dysoRowMap). dysoIdx must be 14bits */
 inline uint32_t getReplicaDysoIdx(const uint32_t& dysoIdx) {
-    return ((dysoIdx & 0x3F) >> 2);  // get [5:2] (4bits)
+    return dysoRowMap.getLocalRow(dysoIdx);  // index among replicas of its core (if checkReplica)
 }
 inline uint32_t getReplicaThreadIdx(const uint32_t& dysoIdx) {
-    return (dysoIdx & 0x3);  // get [1:0] (2bits)
+    return dysoRowMap.getWorker(dysoIdx);
+}
+inline uint32_t getLocalRowIdx(const uint32_t& dysoIdx) {
+    return dysoRowMap.getLocalRow(dysoIdx);  // dense index among the rows of its core (getReplicaThreadIdx)
+}
+inline uint32_t getStatCoreOfRow(const uint32_t& dysoIdx) {
+    return (dysoIdx >> REG_LEN_DYSO_IDX_BIT) % nCoreForStat;  // stat core parsing the msgs of a row, by index_probe (see StatWorkerThread)
 }
 inline uint32_t checkReplica(const uint32_t& dysoIdx, const uint32_t& coreIdx) {
-    return ((dysoIdx >> 6) == 0 && (dysoIdx & 0x3) == coreIdx) ? true : false;  // if [13:6] is 0
+    return (dysoRowMap.getWorker(dysoIdx) == coreIdx && dysoRowMap.getLocalRow(dysoIdx) < N_REPLICA_ROW) ? true : false;
 }
 
 
@@ -71,19 +224,56 @@ inline uint32_t checkReplica(const uint32_t& dysoIdx, const uint32_t& coreIdx) {
  * 
  * The description of connection:
  * 
- * ** DPDK RX Worker <------->  one SPSCRxQueue for each DySO Worker (total 4 expected) 
- * ** one SPSCTxQueue for each DySO worker (total 4 expected) <-------> DPDK TX Worker
+ * ** each DPDK RX Worker (nCoreForStat) <------->  one SPSCRxQueue for each DySO Worker (total nCoreForStat x getNumDysoWorker())
+ * ** one SPSCTxQueue for each DySO worker (total getNumDysoWorker()) <-------> any DPDK TX Worker (nCoreForUpdate), one at a time
+ *
+ * A DySO worker polls its nCoreForStat RX queues in turn. Messages keep their order within an RX queue only,
+ * i.e., an ACK is processed after the signatures received before it by the same DPDK RX Worker.
  */
 
 typedef SPSCQueue<uint64_t, 16384> qRxSPSC;
 typedef SPSCQueue<pcpp::dysoCtrlhdr, 128> qTxSPSC;
+typedef SPSCQueue<pcpp::dysoCtrlhdr, 4096> qFanoutSPSC;  // control headers from the RX stat core to another one (process memory)
+
+/**
+ * In the single-process mode (pcpp_dyso.o -t), DySO workers are threads of the DPDK process,
+ * and the queues are in its (transparent huge page) memory instead of shared memory.
+ * A queue is created by the first thread getting its name, zero-filled as a new shared-memory queue.
+ */
+inline bool& useLocalQueues() {
+    static bool local = false;  // set before any queue is taken
+    return local;
+}
 
-qRxSPSC* getRxQueue(const std::string& name) {
+template <class Q>
+Q* getQueue(const std::string& name) {
+    if (!useLocalQueues())
+        return spsc_shmmap<Q>(name.c_str());
+    static std::mutex mtx;
+    static std::map<std::string, Q*> queues;
+    std::lock_guard<std::mutex> lock(mtx);
+    Q*& queue = queues[name];
+    if (queue == nullptr)
+        queue = hugepage_mmap<Q>(1);
+    return queue;
+}
+
+qRxSPSC* getRxQueue(const uint32_t& statIdx, const uint32_t& workerIdx) {
+    std::string name = std::to_string(statIdx) + "_" + std::to_string(workerIdx);
     // std::cout << "Get SPSC RX queue with name: " << std::string("/shm_dyso_rx_queue_") + name << std::endl;
-    return spsc_shmmap<qRxSPSC>((std::string("/shm_dyso_rx_queue_") + name).c_str());
+    return getQueue<qRxSPSC>(std::string("/shm_dyso_rx_queue_") + name);
 }
 
 qTxSPSC* getTxQueue(const std::string& name) {
     // std::cout << "Get SPSC TX queue with name: " << std::string("/shm_dyso_tx_queue_") + name << std::endl;
-    return spsc_shmmap<qTxSPSC>((std::string("/shm_dyso_tx_queue_") + name).c_str());
+    return getQueue<qTxSPSC>(std::string("/shm_dyso_tx_queue_") + name);
+}
+
+/* doorbell of a DySO worker, rung by stat cores after pushing to its SPSCRxQueues (nullptr if failed) */
+struct DoorbellTable {
+    Doorbell bell[MAX_DYSO_WORKER];
+};
+inline Doorbell* getDoorbell(const uint32_t& workerIdx) {
+    DoorbellTable* table = getQueue<DoorbellTable>("/shm_dyso_doorbell");
+    return (table != nullptr) ? &table->bell[workerIdx] : nullptr;
 }
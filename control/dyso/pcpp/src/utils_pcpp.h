@@ -108,9 +108,10 @@ void printStats(pcpp::DpdkDevice* rxDevice) {
  */
 struct StatWorkerConfig {
     uint32_t CoreId;
+    uint32_t StatIdx;  // index of stat core, i.e., of its SPSCRxQueues to DySO workers
     std::vector<int> rxQueueList;
     pcpp::DpdkDevice* recvPacketFrom;
-    StatWorkerConfig() : CoreId(MAX_NUM_OF_CORES + 1), recvPacketFrom(NULL) {}
+    StatWorkerConfig() : CoreId(MAX_NUM_OF_CORES + 1), StatIdx(0), recvPacketFrom(NULL) {}
 };
 
 /**
@@ -120,11 +121,12 @@ struct StatWorkerConfig {
  */
 struct UpdateWorkerConfig {
     uint32_t CoreId;
+    uint32_t UpdateIdx;  // index of update core (any update core dispatches the SPSCTxQueues of all DySO workers)
     std::vector<int> rxQueueList;
     std::vector<int> txQueueList;
     pcpp::DpdkDevice* recvPacketFrom;
     pcpp::DpdkDevice* sendPacketTo;
-    UpdateWorkerConfig() : CoreId(MAX_NUM_OF_CORES + 1), recvPacketFrom(NULL), sendPacketTo(NULL) {}
+    UpdateWorkerConfig() : CoreId(MAX_NUM_OF_CORES + 1), UpdateIdx(0), recvPacketFrom(NULL), sendPacketTo(NULL) {}
 };
 
 /**
@@ -168,6 +170,7 @@ void prepareCoreConfiguration(pcpp::DpdkDevice* dpdkDeviceStat,
     for (; coreIter != coresAvailable.end(); coreIter++) {
         // assign core
         updateWorkerConfigArr[updateIter].CoreId = coreIter->Id;
+        updateWorkerConfigArr[updateIter].UpdateIdx = updateIter;
         updateWorkerConfigArr[updateIter].recvPacketFrom = dpdkDeviceUpdate;
         updateWorkerConfigArr[updateIter].sendPacketTo = dpdkDeviceUpdate;
 
@@ -222,6 +225,7 @@ void prepareCoreConfiguration(pcpp::DpdkDevice* dpdkDeviceStat,
     for (; coreIter != coresAvailable.end(); coreIter++) {
         // assign core
         statWorkerConfigArr[statIter].CoreId = coreIter->Id;
+        statWorkerConfigArr[statIter].StatIdx = statIter;
         statWorkerConfigArr[statIter].recvPacketFrom = dpdkDeviceStat;
 
         // assign RxQueue per core
@@ -243,8 +247,8 @@ void prepareCoreConfiguration(pcpp::DpdkDevice* dpdkDeviceStat,
             break;
         }
 
-        // sanity check
-        if (idxStatRxQueue >= totalStatNumOfRxQueues) {
+        // sanity check (stat cores after the RxQueues run without one, see StatWorkerThread)
+        if (idxStatRxQueue > totalStatNumOfRxQueues) {
             EXIT_WITH_ERROR("RxQueue allocation is wrong.");
         }
     }
@@ -257,7 +261,7 @@ void prepareCoreConfiguration(pcpp::DpdkDevice* dpdkDeviceStat,
     std::cout << "\n[Config] DPDK UpdateDevice#" << dpdkDeviceUpdate->getDeviceId() << std::endl;
     for (uint32_t i = 0; i < nCoreForUpdate; i++) {
         // print coreId
-        std::cout << "    CoreID: " << updateWorkerConfigArr[i].CoreId << " -> ";
+        std::cout << "    CoreID: " << updateWorkerConfigArr[i].CoreId << " (update " << updateWorkerConfigArr[i].UpdateIdx << ") -> ";
 
         // print RxQueue Ids
         std::cout << "RxQueue: ";
@@ -277,7 +281,7 @@ void prepareCoreConfiguration(pcpp::DpdkDevice* dpdkDeviceStat,
     std::cout << "\n[Config] DPDK StatDevice#" << dpdkDeviceStat->getDeviceId() << std::endl;
     for (uint32_t i = 0; i < nCoreForStat; i++) {
         // print coreId
-        std::cout << "    CoreID: " << statWorkerConfigArr[i].CoreId << " -> ";
+        std::cout << "    CoreID: " << statWorkerConfigArr[i].CoreId << " (stat " << statWorkerConfigArr[i].StatIdx << ") -> ";
 
         // print RxQueue Ids
         std::cout << "RxQueue: ";
@@ -12,12 +12,16 @@ print("*** Remove /dev/shm/ files for sanity")
 subprocess.call('echo {} | sudo -S {}'.format(pwd, 'sudo rm /dev/shm/*'), shell=True) # patronus
 print("->done\n")
 
-print("*** Start setup DySO Workers (wait 20 seconds)")
+print("*** Build the shared keymap of pre-installed keys")
+subprocess.call('echo {} | sudo -S {}'.format(pwd, 'sudo ./control/dyso/pcpp/dyso_keymap.o'), shell=True) # patronus
+print("->done\n")
+
+print("*** Start setup DySO Workers (wait 5 seconds)")
 subprocess.call('echo {} | sudo -S {}'.format(pwd, 'sudo ./control/dyso/pcpp/dyso_multicore.o 0 &'), shell=True) # patronus
 subprocess.call('echo {} | sudo -S {}'.format(pwd, 'sudo ./control/dyso/pcpp/dyso_multicore.o 1 &'), shell=True) # patronus
 subprocess.call('echo {} | sudo -S {}'.format(pwd, 'sudo ./control/dyso/pcpp/dyso_multicore.o 2 &'), shell=True) # patronus
 subprocess.call('echo {} | sudo -S {}'.format(pwd, 'sudo ./control/dyso/pcpp/dyso_multicore.o 3 &'), shell=True) # patronus
-time.sleep(20)
+time.sleep(5)
 print("->done\n")
 
 print("*** Start Pcap++ DPDK Stat/Update Engines (+ 40 seconds waiting)")